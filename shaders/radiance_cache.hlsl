@@ -0,0 +1,70 @@
+#ifndef RADIANCE_CACHE_HLSL
+#define RADIANCE_CACHE_HLSL
+
+// World space radiance leaving voxel faces, stored in an open addressed hash table
+// Expects radianceCache and the resources of trace.hlsl to be declared before being included
+
+#include "shader.hlsl"
+#include "trace.hlsl"
+
+static const int kCacheProbes = 8;
+static const float kCacheRoughness = 0.5f;
+static const float kCacheMinSamples = 4.0f;
+
+// Only faces that scatter mostly diffusely since the cache doesn't store direction
+bool GetCacheKey(Query query, out int3 voxel, out uint face)
+{
+    voxel = int3(floor(query.Position - query.Normal * 0.5f));
+    face = GetNormalIndex(query.Normal);
+    if (!query.Hit || face == 0)
+    {
+        return false;
+    }
+    BlockState block = blockState[query.Block];
+    return block.Light < kEpsilon && block.Roughness >= kCacheRoughness;
+}
+
+bool FindCacheCell(int3 voxel, uint face, out uint index)
+{
+    uint hash = GetCacheHash(voxel, face);
+    uint checksum = GetCacheChecksum(voxel, face);
+    for (int i = 0; i < kCacheProbes; i++)
+    {
+        index = (hash + i) % RADIANCE_CACHE_SIZE;
+        if (radianceCache[index].Checksum == checksum)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Ends a path on a trained cell once it has scattered diffusely
+bool QueryRadianceCache(PathState path, Query query, int bounce, out float3 radiance)
+{
+    radiance = 0.0f;
+    if (bounce == 0 || path.Roughness < kCacheRoughness)
+    {
+        return false;
+    }
+    int3 voxel;
+    uint face;
+    uint index;
+    if (!GetCacheKey(query, voxel, face))
+    {
+        return false;
+    }
+    if (!FindCacheCell(voxel, face, index))
+    {
+        return false;
+    }
+    RadianceCell cell = radianceCache[index];
+    if (cell.Samples < kCacheMinSamples)
+    {
+        return false;
+    }
+    radiance = path.Throughput * cell.Radiance;
+    return true;
+}
+
+#endif
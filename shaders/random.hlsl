@@ -0,0 +1,14 @@
+#ifndef RANDOM_HLSL
+#define RANDOM_HLSL
+
+static uint seed;
+
+// https://www.reedbeta.com/blog/hash-functions-for-gpu-rendering/
+float Random()
+{
+    seed = seed * 747796405u + 2891336453u;
+    const uint x = ((seed >> ((seed >> 28u) + 4u)) ^ seed) * 277803737u;
+    return float((x >> 22u) ^ x) / 4294967296.0f;
+}
+
+#endif
\ No newline at end of file
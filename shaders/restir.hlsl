@@ -0,0 +1,71 @@
+#ifndef RESTIR_HLSL
+#define RESTIR_HLSL
+
+// https://research.nvidia.com/publication/2020-07_spatiotemporal-reservoir-resampling-real-time-ray-tracing-dynamic-direct
+// Expects the resources of trace.hlsl and blockState to be declared before being included
+
+#include "random.hlsl"
+#include "shader.hlsl"
+#include "trace.hlsl"
+
+static const float kSimilarNormal = 0.9f;
+static const float kSimilarDepth = 0.1f;
+
+// Unshadowed light reaching the surface from a point on a light block face
+float GetTargetPdf(ReservoirSurface surface, float3 target, float3 normal, uint block)
+{
+    // The light may have been removed since it was sampled
+    if (GetBlock(int3(floor(target - normal * 0.5f))) != block)
+    {
+        return 0.0f;
+    }
+    float3 offset = target - surface.Position;
+    float distanceSquared = dot(offset, offset);
+    float3 direction = offset * rsqrt(distanceSquared);
+    float cosTheta = dot(surface.Normal, direction);
+    float cosLight = -dot(normal, direction);
+    if (cosTheta <= 0.0f || cosLight <= 0.0f)
+    {
+        return 0.0f;
+    }
+    BlockState state = blockState[block];
+    return dot(GetAlbedo(state) * state.Light, kLuminance) * cosTheta * cosLight / distanceSquared;
+}
+
+void UpdateReservoir(inout Reservoir reservoir, float3 target, float3 normal, uint block, float weight, float m)
+{
+    reservoir.WeightSum += weight;
+    reservoir.M += m;
+    if (weight > 0.0f && Random() * reservoir.WeightSum <= weight)
+    {
+        reservoir.Target = target;
+        reservoir.Normal = normal;
+        reservoir.Block = block;
+    }
+}
+
+// Resamples another reservoir's light against this surface
+void MergeReservoir(inout Reservoir reservoir, Reservoir other, ReservoirSurface surface)
+{
+    float targetPdf = GetTargetPdf(surface, other.Target, other.Normal, other.Block);
+    UpdateReservoir(reservoir, other.Target, other.Normal, other.Block, targetPdf * other.W * other.M, other.M);
+}
+
+void FinalizeReservoir(inout Reservoir reservoir, ReservoirSurface surface)
+{
+    float targetPdf = 0.0f;
+    if (reservoir.WeightSum > 0.0f)
+    {
+        targetPdf = GetTargetPdf(surface, reservoir.Target, reservoir.Normal, reservoir.Block);
+    }
+    reservoir.W = targetPdf > 0.0f ? reservoir.WeightSum / (reservoir.M * targetPdf) : 0.0f;
+}
+
+bool IsSimilarSurface(ReservoirSurface surface, ReservoirSurface other, float depth)
+{
+    return other.Block != kBlockAir &&
+        dot(surface.Normal, other.Normal) > kSimilarNormal &&
+        abs(other.Depth - depth) < depth * kSimilarDepth;
+}
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef SAMPLER_HLSL
+#define SAMPLER_HLSL
+
+// Sample dimensions for the camera jitter and each bounce's decisions, drawn from the sampler picked in
+// the world options. Random() stays in use for everything else
+// Expects worldState and blueNoiseTexture to be declared before being included
+
+#include "random.hlsl"
+#include "shader.hlsl"
+
+static const int kSamplerRandom = 0;
+static const int kSamplerSobol = 1;
+static const int kSamplerBlueNoise = 2;
+static const uint kDimensionCamera = 0;
+static const uint kDimensionHemisphere = 0;
+static const uint kDimensionFresnel = 2;
+static const uint kDimensionRoulette = 3;
+static const uint kDimensionsPerBounce = 4;
+// https://extremelearning.com.au/unreasonable-effectiveness-of-quasirandom-sequences/
+static const uint2 kR2 = uint2(0xC13FA9A9u, 0x91E10DA5u);
+
+static uint2 samplerPixel;
+static uint samplerIndex;
+
+void InitSampler(uint2 pixel, int sample)
+{
+    samplerPixel = pixel;
+    samplerIndex = uint(sample);
+}
+
+uint GetBounceDimension(int bounce, uint dimension)
+{
+    return 2 + bounce * kDimensionsPerBounce + dimension;
+}
+
+// https://jcgt.org/published/0009/04/01/
+uint NestedUniformScramble(uint value, uint seed)
+{
+    value = reversebits(value);
+    value += seed;
+    value ^= value * 0x6C50B47Cu;
+    value ^= value * 0xB82F1E52u;
+    value ^= value * 0xC7AFE638u;
+    value ^= value * 0x8D22F6E6u;
+    return reversebits(value);
+}
+
+uint SobolSecond(uint index)
+{
+    uint result = 0;
+    uint direction = 1u << 31;
+    while (index != 0)
+    {
+        if (index & 1)
+        {
+            result ^= direction;
+        }
+        index >>= 1;
+        direction ^= direction >> 1;
+    }
+    return result;
+}
+
+float ToUnitFloat(uint value)
+{
+    return float(value >> 8) / 16777216.0f;
+}
+
+// Each pair of dimensions is its own shuffled and Owen scrambled 2D Sobol sequence
+float2 SampleSobol(uint dimension)
+{
+    uint seed = HashCache(HashCache(samplerPixel.x ^ HashCache(samplerPixel.y)) ^ dimension);
+    uint index = NestedUniformScramble(samplerIndex, seed);
+    uint x = NestedUniformScramble(reversebits(index), HashCache(seed ^ 1u));
+    uint y = NestedUniformScramble(SobolSecond(index), HashCache(seed ^ 2u));
+    return float2(ToUnitFloat(x), ToUnitFloat(y));
+}
+
+// Offsets the mask per dimension and walks an R2 sequence over frames so each pixel stays stratified in time
+float2 SampleBlueNoise(uint dimension)
+{
+    uint hash = HashCache(dimension + 1u);
+    uint2 position = (samplerPixel + uint2(hash, hash >> 16)) % BLUE_NOISE_SIZE;
+    float x = blueNoiseTexture[position];
+    float y = blueNoiseTexture[(position + BLUE_NOISE_SIZE / 2) % BLUE_NOISE_SIZE];
+    uint2 offset = samplerIndex * kR2;
+    return frac(float2(x, y) + float2(ToUnitFloat(offset.x), ToUnitFloat(offset.y)));
+}
+
+float2 Sample2D(uint dimension)
+{
+    if (worldState[0].Sampler == kSamplerSobol)
+    {
+        return SampleSobol(dimension);
+    }
+    if (worldState[0].Sampler == kSamplerBlueNoise)
+    {
+        return SampleBlueNoise(dimension);
+    }
+    float x = Random();
+    float y = Random();
+    return float2(x, y);
+}
+
+float Sample1D(uint dimension)
+{
+    if (worldState[0].Sampler == kSamplerRandom)
+    {
+        return Random();
+    }
+    float2 value = Sample2D(dimension & ~1u);
+    return (dimension & 1) ? value.y : value.x;
+}
+
+float3 SampleHemisphere(float3 normal, float2 value)
+{
+    float sinTheta = sqrt(value.x);
+    float cosTheta = sqrt(1.0f - value.x);
+    float phi = 2.0f * 3.14159265f * value.y;
+    float3 direction;
+    direction.x = sinTheta * cos(phi);
+    direction.y = cosTheta;
+    direction.z = sinTheta * sin(phi);
+    float3 up;
+    if (abs(normal.y) < 0.999f)
+    {
+        up = float3(0.0f, 1.0f, 0.0f);
+    }
+    else
+    {
+        up = float3(1.0f, 0.0f, 0.0f);
+    }
+    float3 tangent = normalize(cross(up, normal));
+    float3 bitangent = cross(normal, tangent);
+    return tangent * direction.x + normal * direction.y + bitangent * direction.z;
+}
+
+#endif
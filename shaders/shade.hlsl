@@ -0,0 +1,256 @@
+#ifndef SHADE_HLSL
+#define SHADE_HLSL
+
+// Shared by the megakernel and wavefront shade kernel. Expects the resources of trace.hlsl as well as
+// lightBuffer and blueNoiseTexture to be declared before being included
+
+#include "random.hlsl"
+#include "sampler.hlsl"
+#include "shader.hlsl"
+#include "trace.hlsl"
+
+static const float kSunDiskInner = 0.9992f;
+static const float kSunDiskOuter = 0.9996f;
+static const float kSunGlowFalloff = 512.0f;
+static const float kSunDiskBrightness = 4.0f;
+static const int kRouletteBounce = 2;
+static const float3 kPendingColor = float3(0.2f, 0.2f, 0.2f);
+static const float kPi = 3.14159265f;
+
+// https://en.wikipedia.org/wiki/Schlick's_approximation
+float FresnelSchlick(float3 direction, float3 normal, float iorFrom, float iorTo)
+{
+    float cosTheta = saturate(dot(-direction, normal));
+    iorFrom += 1.0f;
+    iorTo += 1.0f;
+    float r0 = (iorFrom - iorTo) / (iorFrom + iorTo);
+    r0 = r0 * r0;
+    return r0 + (1.0f - r0) * pow(1.0f - cosTheta, 5.0f);
+}
+
+// The sun is weighted separately since diffuse bounces already sample it through shadow rays
+float3 GetSky(float3 direction, float sunWeight)
+{
+    float3 sky = lerp(worldState[0].SkyBottom, worldState[0].SkyTop, saturate((direction.y + 1.0f) / 2.0f));
+    float ambient = saturate(worldState[0].SunDirection.y * 4.0f + 0.15f);
+    float disk = smoothstep(kSunDiskInner, kSunDiskOuter, dot(direction, worldState[0].SunDirection));
+    float glow = pow(saturate(dot(direction, worldState[0].SunDirection)), kSunGlowFalloff);
+    float3 emission = worldState[0].SunColor * worldState[0].SunIntensity * (disk * kSunDiskBrightness + glow);
+    return sky * ambient + emission * saturate(worldState[0].SunDirection.y + 0.1f) * sunWeight;
+}
+
+// https://graphics.stanford.edu/courses/cs348b-03/papers/veach-chapter9.pdf
+float PowerHeuristic(float a, float b)
+{
+    return a * a / max(a * a + b * b, kEpsilon);
+}
+
+// Light blocks are sampled by picking one of the faces facing the shading point
+int GetLightFaces(float3 position, int3 light)
+{
+    int faces = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        if (abs(position[i] - light[i] - 0.5f) > 0.5f)
+        {
+            faces++;
+        }
+    }
+    return faces;
+}
+
+// Solid angle pdf of sampling a point on a light block face from the position
+float GetLightPdf(float3 position, float3 target, float3 normal, int faces)
+{
+    float3 offset = target - position;
+    float cosTheta = abs(dot(normalize(offset), normal));
+    if (faces == 0 || cosTheta < kEpsilon)
+    {
+        return 0.0f;
+    }
+    return dot(offset, offset) / (cosTheta * faces * worldState[0].LightCount);
+}
+
+bool SampleLight(float3 position, out float3 target, out float3 normal, out float pdf, out uint block)
+{
+    int index = min(int(Random() * worldState[0].LightCount), worldState[0].LightCount - 1);
+    int4 light = lightBuffer[index];
+    block = light.w;
+    int faces = GetLightFaces(position, light.xyz);
+    normal = 0.0f;
+    if (faces == 0)
+    {
+        pdf = 0.0f;
+        target = 0.0f;
+        return false;
+    }
+    int face = min(int(Random() * faces), faces - 1);
+    target = light.xyz + float3(Random(), Random(), Random());
+    for (int i = 0; i < 3; i++)
+    {
+        float offset = position[i] - light[i] - 0.5f;
+        if (abs(offset) <= 0.5f)
+        {
+            continue;
+        }
+        if (face-- == 0)
+        {
+            normal[i] = sign(offset);
+            target[i] = light[i] + 0.5f + normal[i] * 0.5f;
+            break;
+        }
+    }
+    pdf = GetLightPdf(position, target, normal, faces);
+    return pdf > 0.0f;
+}
+
+// Next event estimation toward either the sun or a light block with a single shadow ray. A valid
+// reservoir replaces light sampling entirely
+ShadowRay SampleDirect(inout PathState path, Query query, BlockState block, Reservoir reservoir)
+{
+    ShadowRay shadow = (ShadowRay) 0;
+    shadow.Origin = query.Position + query.Normal * 0.001f;
+    shadow.Pixel = path.Pixel;
+    float sunFactor = saturate(dot(query.Normal, worldState[0].SunDirection));
+    bool sun = worldState[0].SunDirection.y > 0.0f && sunFactor > 0.0f;
+    bool light = worldState[0].LightCount > 0;
+    float probability = sun && light ? 0.5f : 1.0f;
+    path.LightProbability = reservoir.W > 0.0f ? 0.0f : probability;
+    if (sun && (!light || Random() < 0.5f))
+    {
+        shadow.Direction = worldState[0].SunDirection;
+        shadow.Radiance = path.Throughput * block.Roughness * sunFactor * worldState[0].SunColor * worldState[0].SunIntensity;
+        shadow.Radiance /= probability;
+        return shadow;
+    }
+    if (!light)
+    {
+        return shadow;
+    }
+    if (reservoir.W > 0.0f)
+    {
+        float3 offset = reservoir.Target - shadow.Origin;
+        shadow.Distance = length(offset);
+        shadow.Direction = offset / shadow.Distance;
+        float cosTheta = dot(query.Normal, shadow.Direction);
+        float cosLight = -dot(reservoir.Normal, shadow.Direction);
+        if (cosTheta <= 0.0f || cosLight <= 0.0f)
+        {
+            return shadow;
+        }
+        BlockState lightState = blockState[reservoir.Block];
+        float3 emission = GetAlbedo(lightState) * lightState.Light;
+        float geometry = cosTheta * cosLight / (shadow.Distance * shadow.Distance);
+        shadow.Radiance = path.Throughput * block.Roughness / kPi * emission * geometry * reservoir.W / probability;
+        return shadow;
+    }
+    float3 target;
+    float3 lightNormal;
+    float lightPdf;
+    uint lightBlock;
+    if (!SampleLight(shadow.Origin, target, lightNormal, lightPdf, lightBlock))
+    {
+        return shadow;
+    }
+    float3 offset = target - shadow.Origin;
+    shadow.Distance = length(offset);
+    shadow.Direction = offset / shadow.Distance;
+    float cosTheta = dot(query.Normal, shadow.Direction);
+    if (cosTheta <= 0.0f)
+    {
+        return shadow;
+    }
+    BlockState lightState = blockState[lightBlock];
+    float3 emission = GetAlbedo(lightState) * lightState.Light;
+    float bsdfPdf = block.Roughness * cosTheta / kPi;
+    lightPdf *= probability;
+    shadow.Radiance = path.Throughput * block.Roughness * emission * cosTheta / kPi / lightPdf;
+    shadow.Radiance *= PowerHeuristic(lightPdf, bsdfPdf);
+    return shadow;
+}
+
+// Returns false once the path terminates. Visibility of the direct lighting is left to the caller
+// through the shadow ray
+bool ShadePath(inout PathState path, Query query, int bounce, Reservoir reservoir, inout float3 radiance, out ShadowRay shadow)
+{
+    shadow = (ShadowRay) 0;
+    if (query.Pending)
+    {
+        radiance += path.Throughput * kPendingColor;
+        return false;
+    }
+    if (!query.Hit)
+    {
+        radiance += path.Throughput * GetSky(path.Direction, 1.0f - path.Roughness);
+        return false;
+    }
+    BlockState block = blockState[query.Block];
+    if (bounce == 0 && length(query.Normal) < kEpsilon)
+    {
+        path.IOR = block.IOR;
+        return true;
+    }
+    if (query.Block != kBlockAir)
+    {
+        float3 albedo = GetAlbedo(block);
+        float3 emission = albedo * block.Light;
+        // Weighted against the chance that the previous bounce's shadow ray sampled this light instead
+        // (or dropped when a reservoir did, shown by a zero light probability)
+        if (block.Light > kEpsilon && path.BsdfPdf > 0.0f && worldState[0].LightCount > 0)
+        {
+            int3 light = int3(floor(query.Position - query.Normal * 0.5f));
+            int faces = GetLightFaces(path.Origin, light);
+            float lightPdf = GetLightPdf(path.Origin, query.Position, query.Normal, faces) * path.LightProbability;
+            emission *= path.LightProbability > 0.0f ? PowerHeuristic(path.BsdfPdf, lightPdf) : 0.0f;
+        }
+        radiance += path.Throughput * emission;
+        path.Throughput *= albedo;
+    }
+    if (block.IOR > kEpsilon || (path.IOR > kEpsilon && query.Block == kBlockAir))
+    {
+        if (Sample1D(GetBounceDimension(bounce, kDimensionFresnel)) > FresnelSchlick(path.Direction, query.Normal, path.IOR, block.IOR))
+        {
+            float3 refracted = refract(path.Direction, query.Normal, (1.0f + path.IOR) / (1.0f + block.IOR));
+            if (length(refracted) > kEpsilon)
+            {
+                path.Direction = refracted;
+                path.Origin = query.Position + path.Direction * 0.001f;
+                path.IOR = block.IOR;
+                path.BsdfPdf = 0.0f;
+                path.Roughness = 0.0f;
+                return true;
+            }
+        }
+    }
+    if (block.Light > kEpsilon)
+    {
+        return false;
+    }
+    if (query.Block != kBlockAir && block.Roughness > kEpsilon)
+    {
+        if (bounce > 0)
+        {
+            reservoir = (Reservoir) 0;
+        }
+        shadow = SampleDirect(path, query, block, reservoir);
+    }
+    float3 reflected = reflect(path.Direction, query.Normal);
+    float3 diffuse = SampleHemisphere(query.Normal, Sample2D(GetBounceDimension(bounce, kDimensionHemisphere)));
+    path.Direction = normalize(lerp(reflected, diffuse, block.Roughness));
+    path.Origin = query.Position + query.Normal * 0.001f;
+    // Only the diffuse part is treated as a density for MIS since the reflection is a delta
+    path.BsdfPdf = block.Roughness * saturate(dot(query.Normal, path.Direction)) / kPi;
+    path.Roughness = block.Roughness;
+    if (bounce >= kRouletteBounce)
+    {
+        float probability = saturate(max(path.Throughput.r, max(path.Throughput.g, path.Throughput.b)));
+        if (probability < kEpsilon || Sample1D(GetBounceDimension(bounce, kDimensionRoulette)) > probability)
+        {
+            return false;
+        }
+        path.Throughput /= probability;
+    }
+    return true;
+}
+
+#endif
\ No newline at end of file
@@ -14,7 +14,27 @@ struct WorldState
     float SunIntensity;
     float3 SunDirection;
     float TimeOfDay;
+    int Temporal;
+    int MaxHistory;
+    int DenoiseIterations;
+    float EditRadius;
+    int Wavefront;
+    int Restir;
+    int RadianceCache;
+    int SunCache;
+    float AdaptiveThreshold;
+    int UpscaleFactor;
+    int Sampler;
+    int RetraceInterval;
+    int RaySorting;
+    int HalfAccumulation;
+    float Exposure;
+    int Tonemapper;
+    int Foveated;
+    float FoveaRadius;
     int2 Position;
+    int LightCount;
+    int Padding2;
 };
 
 struct CameraState
@@ -37,8 +57,256 @@ struct BlockState
     float IOR;
 };
 
+struct PathState
+{
+    float3 Origin;
+    uint Pixel;
+    float3 Direction;
+    float IOR;
+    float3 Throughput;
+    uint Seed;
+    float BsdfPdf;
+    float Roughness;
+    float LightProbability;
+    float Padding1;
+};
+
+struct ShadowRay
+{
+    float3 Origin;
+    uint Pixel;
+    float3 Direction;
+    float Distance;
+    float3 Radiance;
+    uint Cell;
+};
+
+struct PathHit
+{
+    float3 Position;
+    uint Block;
+    float3 Normal;
+    uint Flags;
+};
+
+struct PrimaryHit
+{
+    float3 Position;
+    uint Block;
+    float3 Normal;
+    uint Flags;
+    float3 Direction;
+    float IOR;
+};
+
+struct Reservoir
+{
+    float3 Target;
+    uint Block;
+    float3 Normal;
+    float WeightSum;
+    float M;
+    float W;
+    float Padding1;
+    float Padding2;
+};
+
+struct ReservoirSurface
+{
+    float3 Position;
+    uint Block;
+    float3 Normal;
+    float Depth;
+};
+
+struct RadianceCell
+{
+    int3 Voxel;
+    uint Checksum;
+    float3 Radiance;
+    float Samples;
+    uint SumR;
+    uint SumG;
+    uint SumB;
+    uint Count;
+    uint Face;
+    uint Frame;
+    uint Padding1;
+    uint Padding2;
+};
+
+struct SunCell
+{
+    int3 Voxel;
+    uint State;
+};
+
 static const uint kBlockAir = 0;
 static const uint kBlockWater = 9;
+static const uint kGroupEmpty = 0;
+static const uint kGroupOccupied = 1;
+static const uint kGroupWater = 2;
 static const float kEpsilon = 0.001f;
+static const float3 kLuminance = float3(0.2126f, 0.7152f, 0.0722f);
+static const uint kHitFlagsHit = 0x01;
+static const uint kHitFlagsPending = 0x02;
+static const float kRadianceScale = 1024.0f;
+static const float kAdaptiveMinSamples = 16.0f;
+static const float kAdaptiveMinLuminance = 0.05f;
+static const uint kUpscaleJitterCount = 16;
+static const int kTonemapperNone = 0;
+static const int kTonemapperReinhard = 1;
+static const int kTonemapperAces = 2;
+static const uint kFoveaBlock = 4;
+static const uint kStatPaths = 0;
+static const uint kStatStepLimit = 1;
+static const uint kStatBounceLimit = 2;
+
+// Shared by the world space caches keyed by voxel face
+uint HashCache(uint value)
+{
+    uint state = value * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+uint GetCacheHash(int3 voxel, uint face)
+{
+    return HashCache(uint(voxel.x) + HashCache(uint(voxel.y) + HashCache(uint(voxel.z) + HashCache(face))));
+}
+
+// Mixed differently from the hash so that cells sharing a slot rarely share a checksum (zero is empty)
+uint GetCacheChecksum(int3 voxel, uint face)
+{
+    return max(HashCache(face ^ HashCache(uint(voxel.z) ^ HashCache(uint(voxel.y) ^ HashCache(uint(voxel.x) ^ 0x9E3779B9u)))), 1u);
+}
+
+// Exposure in stops followed by the tonemapper picked in the world options
+float3 Tonemap(float3 color, WorldState state)
+{
+    color *= exp2(state.Exposure);
+    if (state.Tonemapper == kTonemapperReinhard)
+    {
+        return color / (1.0f + dot(color, kLuminance));
+    }
+    if (state.Tonemapper == kTonemapperAces)
+    {
+        // https://knarkowicz.wordpress.com/2016/01/06/aces-filmic-tone-mapping-curve/
+        return saturate((color * (2.51f * color + 0.03f)) / (color * (2.43f * color + 0.59f) + 0.14f));
+    }
+    return saturate(color);
+}
+
+// Bins paths by the chunk they start in and the octant they head toward
+uint GetSortKey(PathState path, WorldState state)
+{
+    int2 chunk = (int2(floor(path.Origin.xz)) - state.Position * CHUNK_WIDTH) >> CHUNK_SHIFT;
+    chunk = clamp(chunk, 0, WORLD_WIDTH - 1);
+    uint octant = (path.Direction.x < 0.0f ? 1 : 0) | (path.Direction.y < 0.0f ? 2 : 0) | (path.Direction.z < 0.0f ? 4 : 0);
+    return (chunk.x + chunk.y * WORLD_WIDTH) * 8 + octant;
+}
+
+// Staggered so that a different subset of pixels retraces its primary ray every frame
+bool IsPrimaryCached(uint2 pixel, int sample, int interval)
+{
+    return interval > 1 && (HashCache(pixel.x | (pixel.y << 16)) + uint(sample)) % uint(interval) != 0;
+}
+
+// Shading rate around the crosshair (1 inside the fovea, then 2x2 and 4x4 blocks further out)
+// Decided per 4x4 block so that the smaller blocks never straddle two rates
+uint GetFoveaRate(uint2 pixel, uint2 size, WorldState state)
+{
+    if (!state.Foveated)
+    {
+        return 1;
+    }
+    float2 center = float2(pixel / kFoveaBlock * kFoveaBlock) + kFoveaBlock / 2.0f - float2(size) / 2.0f;
+    float distance = length(center) / float(size.y);
+    if (distance < state.FoveaRadius)
+    {
+        return 1;
+    }
+    if (distance < state.FoveaRadius * 2.0f)
+    {
+        return 2;
+    }
+    return 4;
+}
+
+// The one pixel of each block traced this frame, rotating through the whole block over rate * rate frames
+uint2 GetFoveaPixel(uint2 pixel, uint2 size, int sample, uint rate)
+{
+    uint2 block = pixel / rate;
+    uint index = (HashCache(block.x | (block.y << 16)) + uint(sample)) % (rate * rate);
+    return min(block * rate + uint2(index % rate, index / rate), size - 1);
+}
+
+int GetFoveaBounces(uint rate, WorldState state)
+{
+    return (state.MaxBounces + int(rate) - 1) / int(rate);
+}
+
+// Relative standard error of the accumulated luminance against the threshold (zero disables)
+bool IsConverged(float4 color, float4 moments, float threshold)
+{
+    if (threshold <= 0.0f || color.a < kAdaptiveMinSamples)
+    {
+        return false;
+    }
+    float variance = max(moments.y - moments.x * moments.x, 0.0f);
+    return sqrt(variance / color.a) <= threshold * max(moments.x, kAdaptiveMinLuminance);
+}
+
+float3 GetAlbedo(BlockState block)
+{
+    float3 albedo;
+    albedo.r = float((block.Color >> 24) & 0xFFu) / 255.0f;
+    albedo.g = float((block.Color >> 16) & 0xFFu) / 255.0f;
+    albedo.b = float((block.Color >> 8) & 0xFFu) / 255.0f;
+    return albedo;
+}
+
+float3 GetCameraDirection(CameraState camera, float2 uv)
+{
+    float u = (2.0f * uv.x - 1.0f) * camera.AspectRatio * camera.TanHalfFov;
+    float v = (1.0f - 2.0f * uv.y) * camera.TanHalfFov;
+    return normalize(u * camera.Right - v * camera.Up + camera.Forward);
+}
+
+// Inverse of GetCameraDirection for a camera relative offset
+bool GetCameraUV(CameraState camera, float3 offset, out float2 uv)
+{
+    float z = dot(offset, camera.Forward);
+    if (z < kEpsilon)
+    {
+        uv = 0.0f;
+        return false;
+    }
+    float u = dot(offset, camera.Right) / z;
+    float v = -dot(offset, camera.Up) / z;
+    uv.x = (u / (camera.AspectRatio * camera.TanHalfFov) + 1.0f) / 2.0f;
+    uv.y = (1.0f - v / camera.TanHalfFov) / 2.0f;
+    return true;
+}
+
+float Halton(uint index, uint base)
+{
+    float result = 0.0f;
+    float fraction = 1.0f;
+    while (index > 0)
+    {
+        fraction /= base;
+        result += fraction * (index % base);
+        index /= base;
+    }
+    return result;
+}
+
+// Subpixel offset shared by every pixel in a frame so the upscale knows where each sample landed
+float2 GetUpscaleJitter(int sample)
+{
+    uint index = uint(sample) % kUpscaleJitterCount + 1;
+    return float2(Halton(index, 2), Halton(index, 3));
+}
 
 #endif
\ No newline at end of file
@@ -0,0 +1,90 @@
+#ifndef SUN_CACHE_HLSL
+#define SUN_CACHE_HLSL
+
+// Sun visibility of voxel face texels, filled lazily by the first shadow ray toward the sun. The low
+// bits of a cell's state hold the visibility and the rest hold the checksum
+// Expects sunCache and the resources of trace.hlsl to be declared before being included
+
+#include "shader.hlsl"
+#include "trace.hlsl"
+
+static const uint kSunUnknown = 0;
+static const uint kSunOccluded = 1;
+static const uint kSunVisible = 2;
+static const int kSunProbes = 8;
+
+// Snaps the shadow ray to the center of its face texel so that every pixel on the texel agrees
+bool GetSunKey(Query query, inout ShadowRay shadow, out int3 voxel, out uint key)
+{
+    voxel = int3(floor(query.Position - query.Normal * 0.5f));
+    key = GetNormalIndex(query.Normal);
+    if (!query.Hit || key == 0 || shadow.Distance > 0.0f)
+    {
+        return false;
+    }
+    int axis = (key - 1) / 2;
+    float3 center = query.Position;
+    for (int i = 0; i < 3; i++)
+    {
+        if (i == axis)
+        {
+            continue;
+        }
+        float texel = clamp(floor((query.Position[i] - voxel[i]) * SUN_CACHE_TEXELS), 0.0f, SUN_CACHE_TEXELS - 1.0f);
+        center[i] = voxel[i] + (texel + 0.5f) / SUN_CACHE_TEXELS;
+        key = key * SUN_CACHE_TEXELS + uint(texel);
+    }
+    shadow.Origin = center + query.Normal * 0.001f;
+    return true;
+}
+
+// Finds or reserves the cell, where a new (or unavailable) cell is unknown
+uint FindSunCell(int3 voxel, uint key, out uint index)
+{
+    uint hash = GetCacheHash(voxel, key);
+    uint checksum = max(GetCacheChecksum(voxel, key) & ~3u, 4u);
+    for (int i = 0; i < kSunProbes; i++)
+    {
+        index = (hash + i) % SUN_CACHE_SIZE;
+        uint previous;
+        InterlockedCompareExchange(sunCache[index].State, 0u, checksum, previous);
+        if (previous == 0u)
+        {
+            sunCache[index].Voxel = voxel;
+            return kSunUnknown;
+        }
+        if ((previous & ~3u) == checksum)
+        {
+            return previous & 3u;
+        }
+    }
+    index = SUN_CACHE_SIZE;
+    return kSunUnknown;
+}
+
+// Sets the cell the shadow ray should fill in when it's unknown
+uint QuerySunCache(Query query, inout ShadowRay shadow)
+{
+    shadow.Cell = SUN_CACHE_SIZE;
+    if (!worldState[0].SunCache)
+    {
+        return kSunUnknown;
+    }
+    int3 voxel;
+    uint key;
+    if (!GetSunKey(query, shadow, voxel, key))
+    {
+        return kSunUnknown;
+    }
+    return FindSunCell(voxel, key, shadow.Cell);
+}
+
+void SetSunVisibility(uint index, bool visible)
+{
+    if (index < SUN_CACHE_SIZE)
+    {
+        InterlockedOr(sunCache[index].State, visible ? kSunVisible : kSunOccluded);
+    }
+}
+
+#endif
@@ -0,0 +1,354 @@
+#ifndef TRACE_HLSL
+#define TRACE_HLSL
+
+// Shared by the megakernel and wavefront kernels. Expects blockTexture, groupTexture, chunkTexture,
+// worldState and blockState to be declared before being included
+
+#include "shader.hlsl"
+
+struct Query
+{
+    bool Hit;
+    bool Pending;
+    uint Block;
+    float3 Position;
+    float3 Normal;
+    bool Truncated;
+};
+
+// Shadow rays walk through any refractive blocks in one go so they get a few times the step budget
+static const int kShadowStepScale = 4;
+
+// Zero is reserved for pixels without a primary hit
+uint GetNormalIndex(float3 normal)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        if (normal[i] > 0.5f)
+        {
+            return i * 2 + 1;
+        }
+        if (normal[i] < -0.5f)
+        {
+            return i * 2 + 2;
+        }
+    }
+    return 0;
+}
+
+int GetStepAxis(float3 distance)
+{
+    if (distance.x < distance.y)
+    {
+        return distance.x < distance.z ? 0 : 2;
+    }
+    else
+    {
+        return distance.y < distance.z ? 1 : 2;
+    }
+}
+
+// Air outside of the loaded chunks
+uint GetBlock(int3 voxel)
+{
+    int3 position = voxel;
+    position.x -= worldState[0].Position.x * CHUNK_WIDTH;
+    position.z -= worldState[0].Position.y * CHUNK_WIDTH;
+    if (position.x < 0 || position.y < 0 || position.z < 0 ||
+        position.x >= WORLD_WIDTH * CHUNK_WIDTH ||
+        position.y >= CHUNK_HEIGHT ||
+        position.z >= WORLD_WIDTH * CHUNK_WIDTH)
+    {
+        return kBlockAir;
+    }
+    uint2 chunk = uint2(position.xz) >> CHUNK_SHIFT;
+    position.x -= chunk.x * CHUNK_WIDTH;
+    position.z -= chunk.y * CHUNK_WIDTH;
+    chunk = chunkTexture[chunk];
+    if (chunk.x & CHUNK_PENDING)
+    {
+        return kBlockAir;
+    }
+    position.x += chunk.x * CHUNK_WIDTH;
+    position.z += chunk.y * CHUNK_WIDTH;
+    return blockTexture[position];
+}
+
+// Outside of the loaded chunks is empty like GetBlock. Pending chunks aren't so rays still stop at them
+bool IsGroupEmpty(int3 group)
+{
+    int3 position = group << GROUP_SHIFT;
+    position.x -= worldState[0].Position.x * CHUNK_WIDTH;
+    position.z -= worldState[0].Position.y * CHUNK_WIDTH;
+    if (position.x < 0 || position.y < 0 || position.z < 0 ||
+        position.x >= WORLD_WIDTH * CHUNK_WIDTH ||
+        position.y >= CHUNK_HEIGHT ||
+        position.z >= WORLD_WIDTH * CHUNK_WIDTH)
+    {
+        return true;
+    }
+    uint2 chunk = uint2(position.xz) >> CHUNK_SHIFT;
+    position.x -= chunk.x * CHUNK_WIDTH;
+    position.z -= chunk.y * CHUNK_WIDTH;
+    chunk = chunkTexture[chunk];
+    if (chunk.x & CHUNK_PENDING)
+    {
+        return false;
+    }
+    position.x += chunk.x * CHUNK_WIDTH;
+    position.z += chunk.y * CHUNK_WIDTH;
+    return groupTexture[position >> GROUP_SHIFT] == kGroupEmpty;
+}
+
+// Moves the traversal to the first voxel past the empty group it's in and returns the axis it crossed
+int SkipGroup(float3 origin, float3 direction, float3 delta, int3 step, inout int3 voxel, inout float3 distance)
+{
+    int3 groupVoxel = voxel >> GROUP_SHIFT;
+    int3 groupBoundary;
+    for (int j = 0; j < 3; j++)
+    {
+        if (step[j] > 0)
+        {
+            groupBoundary[j] = (groupVoxel[j] + 1) * GROUP_SIZE;
+        }
+        else
+        {
+            groupBoundary[j] = groupVoxel[j] * GROUP_SIZE;
+        }
+    }
+    float3 groupDistance;
+    for (int j = 0; j < 3; j++)
+    {
+        if (step[j] > 0)
+        {
+            groupDistance[j] = distance[j] + (groupBoundary[j] - voxel[j] - 1) * delta[j];
+        }
+        else
+        {
+            groupDistance[j] = distance[j] + (voxel[j] - groupBoundary[j]) * delta[j];
+        }
+    }
+    int axis = GetStepAxis(groupDistance);
+    float t = groupDistance[axis];
+    groupVoxel[axis] += step[axis];
+    float3 hitPosition = origin + direction * t;
+    voxel = int3(floor(hitPosition));
+    voxel[axis] = groupVoxel[axis] * GROUP_SIZE + (step[axis] > 0 ? 0 : (GROUP_SIZE - 1));
+    voxel = clamp(voxel, groupVoxel * GROUP_SIZE, groupVoxel * GROUP_SIZE + GROUP_SIZE - 1);
+    for (int j = 0; j < 3; j++)
+    {
+        if (step[j] > 0)
+        {
+            distance[j] = (voxel[j] + 1.0f - origin[j]) * delta[j];
+        }
+        else
+        {
+            distance[j] = (origin[j] - voxel[j]) * delta[j];
+        }
+    }
+    return axis;
+}
+
+Query Raycast(float3 origin, float3 direction, float ior)
+{
+    int3 voxel = int3(floor(origin));
+    float3 delta = abs(1.0f / direction);
+    int3 step;
+    float3 distance;
+    int axis = -1;
+    for (int i = 0; i < 3; i++)
+    {
+        if (direction[i] < 0.0f)
+        {
+            step[i] = -1;
+            distance[i] = (origin[i] - voxel[i]) * delta[i];
+        }
+        else
+        {
+            step[i] = 1;
+            distance[i] = (voxel[i] + 1.0f - origin[i]) * delta[i];
+        }
+    }
+    // Groups of nothing but water are as empty as air to a ray already travelling through water
+    bool skipWater = ior > kEpsilon && abs(blockState[kBlockWater].IOR - ior) <= kEpsilon;
+    int maxSteps = worldState[0].MaxSteps;
+    int offsetX = worldState[0].Position.x * CHUNK_WIDTH;
+    int offsetZ = worldState[0].Position.y * CHUNK_WIDTH;
+    for (int i = 0; i < maxSteps; i++)
+    {
+        int3 position = voxel;
+        position.x -= offsetX;
+        position.z -= offsetZ;
+        if (position.x < 0 || position.z < 0 ||
+            position.x >= WORLD_WIDTH * CHUNK_WIDTH ||
+            position.z >= WORLD_WIDTH * CHUNK_WIDTH ||
+            (step.y > 0 && position.y > CHUNK_HEIGHT))
+        {
+            Query query;
+            query.Hit = false;
+            query.Pending = false;
+            query.Truncated = false;
+            return query;
+        }
+        uint2 chunk = uint2(position.xz) >> CHUNK_SHIFT;
+        position.x -= chunk.x * CHUNK_WIDTH;
+        position.z -= chunk.y * CHUNK_WIDTH;
+        chunk = chunkTexture[chunk];
+        if (chunk.x & CHUNK_PENDING)
+        {
+            Query query;
+            query.Hit = false;
+            query.Pending = true;
+            query.Truncated = false;
+            return query;
+        }
+        position.x += chunk.x * CHUNK_WIDTH;
+        position.z += chunk.y * CHUNK_WIDTH;
+        int3 groupPosition = position >> GROUP_SHIFT;
+        uint groupValue = groupTexture[groupPosition];
+        if (groupValue == kGroupEmpty || (skipWater && groupValue == kGroupWater))
+        {
+            axis = SkipGroup(origin, direction, delta, step, voxel, distance);
+            continue;
+        }
+        uint hitBlock = blockTexture[position];
+        if (ior > kEpsilon || hitBlock != kBlockAir)
+        {
+            BlockState block = blockState[hitBlock];
+            bool refract = ior > kEpsilon || block.IOR > kEpsilon;
+            if ((!refract && hitBlock != kBlockAir) || (refract && abs(block.IOR - ior) > kEpsilon))
+            {
+                float3 normal = float3(0.0f, 0.0f, 0.0f);
+                normal[axis] = -step[axis];
+                float t = distance[axis] - delta[axis];
+                Query query;
+                query.Hit = true;
+                query.Pending = false;
+                query.Block = hitBlock;
+                query.Position = origin + direction * t;
+                query.Normal = normal;
+                query.Truncated = false;
+                return query;
+            }
+        }
+        axis = GetStepAxis(distance);
+        distance[axis] += delta[axis];
+        voxel[axis] += step[axis];
+    }
+    // Ran out of steps before hitting anything or leaving the world
+    Query query;
+    query.Hit = false;
+    query.Pending = false;
+    query.Truncated = true;
+    return query;
+}
+
+Query GetPrimaryQuery(PrimaryHit hit)
+{
+    Query query;
+    query.Hit = (hit.Flags & kHitFlagsHit) != 0;
+    query.Pending = (hit.Flags & kHitFlagsPending) != 0;
+    query.Block = hit.Block;
+    query.Position = hit.Position;
+    query.Normal = hit.Normal;
+    // Already counted when it was traced
+    query.Truncated = false;
+    return query;
+}
+
+PrimaryHit GetPrimaryHit(Query query, float3 direction, float ior)
+{
+    PrimaryHit hit = (PrimaryHit) 0;
+    hit.Direction = direction;
+    hit.IOR = ior;
+    if (query.Hit)
+    {
+        hit.Position = query.Position;
+        hit.Block = query.Block;
+        hit.Normal = query.Normal;
+        hit.Flags = kHitFlagsHit;
+    }
+    else if (query.Pending)
+    {
+        hit.Flags = kHitFlagsPending;
+    }
+    return hit;
+}
+
+// Visibility only so it skips the normals and medium tracking of Raycast and walks through refractive
+// blocks (e.g. water) in the same pass since they only tint the light. Rays with a distance (toward
+// light blocks) are unoccluded once they reach it
+bool TraceShadow(ShadowRay shadow)
+{
+    float3 origin = shadow.Origin;
+    float3 direction = shadow.Direction;
+    int3 voxel = int3(floor(origin));
+    float3 delta = abs(1.0f / direction);
+    int3 step;
+    float3 distance;
+    for (int i = 0; i < 3; i++)
+    {
+        if (direction[i] < 0.0f)
+        {
+            step[i] = -1;
+            distance[i] = (origin[i] - voxel[i]) * delta[i];
+        }
+        else
+        {
+            step[i] = 1;
+            distance[i] = (voxel[i] + 1.0f - origin[i]) * delta[i];
+        }
+    }
+    float maxDistance = shadow.Distance > 0.0f ? shadow.Distance - 0.01f : 1e30f;
+    int maxSteps = worldState[0].MaxSteps * kShadowStepScale;
+    int offsetX = worldState[0].Position.x * CHUNK_WIDTH;
+    int offsetZ = worldState[0].Position.y * CHUNK_WIDTH;
+    int axis = -1;
+    for (int i = 0; i < maxSteps; i++)
+    {
+        // Distance to where the ray entered the current voxel
+        float t = axis < 0 ? 0.0f : distance[axis] - delta[axis];
+        if (t >= maxDistance)
+        {
+            return true;
+        }
+        int3 position = voxel;
+        position.x -= offsetX;
+        position.z -= offsetZ;
+        if (position.x < 0 || position.z < 0 ||
+            position.x >= WORLD_WIDTH * CHUNK_WIDTH ||
+            position.z >= WORLD_WIDTH * CHUNK_WIDTH ||
+            (step.y > 0 && position.y > CHUNK_HEIGHT))
+        {
+            return true;
+        }
+        uint2 chunk = uint2(position.xz) >> CHUNK_SHIFT;
+        position.x -= chunk.x * CHUNK_WIDTH;
+        position.z -= chunk.y * CHUNK_WIDTH;
+        chunk = chunkTexture[chunk];
+        if (chunk.x & CHUNK_PENDING)
+        {
+            return true;
+        }
+        position.x += chunk.x * CHUNK_WIDTH;
+        position.z += chunk.y * CHUNK_WIDTH;
+        // Water never occludes so groups of only water are skipped like empty ones
+        uint groupValue = groupTexture[position >> GROUP_SHIFT];
+        if (groupValue == kGroupEmpty || groupValue == kGroupWater)
+        {
+            axis = SkipGroup(origin, direction, delta, step, voxel, distance);
+            continue;
+        }
+        uint block = blockTexture[position];
+        if (block != kBlockAir && blockState[block].IOR <= kEpsilon)
+        {
+            return false;
+        }
+        axis = GetStepAxis(distance);
+        distance[axis] += delta[axis];
+        voxel[axis] += step[axis];
+    }
+    return true;
+}
+
+#endif
\ No newline at end of file
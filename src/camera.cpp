@@ -94,6 +94,11 @@ SDL_GPUBuffer* Camera::GetBuffer() const
     return State.GetBuffer();
 }
 
+const CameraState& Camera::GetState() const
+{
+    return *State;
+}
+
 void Camera::SetPosition(const glm::vec3& position)
 {
     State.Get().Position = position;
@@ -29,6 +29,7 @@ public:
     void SetFov(float fov);
     void Upload(SDL_GPUDevice* device, SDL_GPUCopyPass* copyPass);
     SDL_GPUBuffer* GetBuffer() const;
+    const CameraState& GetState() const;
     void SetPosition(const glm::vec3& position);
     const glm::vec3& GetPosition() const;
     const glm::vec3& GetDirection() const;
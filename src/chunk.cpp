@@ -24,12 +24,11 @@ enum Biome
     BiomeInvalid,
 };
 
-static void GenerateTree(WorldProxy& proxy, int x, int y, int z, Block wood, Block leaves, float detail)
+static void GenerateTree(WorldProxy& proxy, int x, int y, int z, Block wood, Block leaves, int offset)
 {
-    int offset = 3 + detail * 2.0f;
     for (int i = 1; i <= offset; i++)
     {
-        if (y + i < Chunk::kHeight)
+        if (y + i < Chunk::kHeight && proxy.GetBlock({x, y + i, z}) == BlockAir)
         {
             proxy.SetBlock({x, y + i, z}, wood);
         }
@@ -47,7 +46,8 @@ static void GenerateTree(WorldProxy& proxy, int x, int y, int z, Block wood, Blo
             int lx = x + dx;
             int ly = y + offset + dy;
             int lz = z + dz;
-            if (lx >= 0 && lx < Chunk::kWidth && ly >= 0 && ly < Chunk::kHeight && lz >= 0 && lz < Chunk::kWidth)
+            if (lx >= 0 && lx < Chunk::kWidth && ly >= 0 && ly < Chunk::kHeight && lz >= 0 && lz < Chunk::kWidth &&
+                proxy.GetBlock({lx, ly, lz}) == BlockAir)
             {
                 proxy.SetBlock({lx, ly, lz}, leaves);
             }
@@ -55,51 +55,85 @@ static void GenerateTree(WorldProxy& proxy, int x, int y, int z, Block wood, Blo
     }
 }
 
+struct TerrainNoise
+{
+    TerrainNoise();
+
+    FastNoiseLite BaseNoise;
+    FastNoiseLite DetailNoise;
+    FastNoiseLite TreeNoise;
+    FastNoiseLite BiomeNoise;
+    FastNoiseLite RidgeNoise;
+    FastNoiseLite MountainNoise;
+};
+
+TerrainNoise::TerrainNoise()
+{
+    BaseNoise.SetFrequency(0.01f);
+    DetailNoise.SetFrequency(0.05f);
+    TreeNoise.SetFrequency(0.1f);
+    BiomeNoise.SetNoiseType(FastNoiseLite::NoiseType_Cellular);
+    BiomeNoise.SetFrequency(0.01f);
+    BiomeNoise.SetCellularReturnType(FastNoiseLite::CellularReturnType_CellValue);
+    RidgeNoise.SetFractalType(FastNoiseLite::FractalType_Ridged);
+    RidgeNoise.SetFrequency(0.004f);
+    RidgeNoise.SetFractalOctaves(6);
+    MountainNoise.SetFrequency(0.002f);
+    MountainNoise.SetFractalType(FastNoiseLite::FractalType_FBm);
+    MountainNoise.SetFractalOctaves(3);
+}
+
+static int GetHeight(const TerrainNoise& noise, float x, float z, float& detail, bool& mountain)
+{
+    float ridge = 0.0f;
+    float value = (noise.MountainNoise.GetNoise(x, z) + 1.0f) * 0.5f;
+    detail = (noise.DetailNoise.GetNoise(x, z) + 1.0f) * 0.5f;
+    mountain = value > 0.45f + (detail - 0.5f) * 0.05f;
+    if (mountain)
+    {
+        float weight = (value - 0.45f) / 0.55f;
+        weight = std::pow(weight, 0.8f);
+        ridge = (noise.RidgeNoise.GetNoise(x, z) + 1.0f) * 0.5f * 120.0f * weight;
+    }
+    float base = (noise.BaseNoise.GetNoise(x, z) + 1.0f) * 0.5f * 15.0f;
+    int height = base + detail * 4.0f + ridge;
+    return std::clamp(height, 1, kMaxHeight);
+}
+
 Chunk::Chunk()
     : Flags{ChunkFlagsNone}
+    , Next{nullptr}
 {
 }
 
 void Chunk::Generate(WorldProxy& proxy, int chunkX, int chunkZ)
+{
+    ChunkTree trees[kWidth * kWidth];
+    for (int tile = 0; tile < kTileCount; tile++)
+    {
+        GenerateTile(proxy, chunkX, chunkZ, tile, trees);
+    }
+    Decorate(proxy, trees);
+}
+
+void Chunk::GenerateTile(WorldProxy& proxy, int chunkX, int chunkZ, int tile, ChunkTree* trees) const
 {
     SDL_assert(Flags & ChunkFlagsGenerate);
-    FastNoiseLite baseNoise;
-    FastNoiseLite detailNoise;
-    FastNoiseLite treeNoise;
-    FastNoiseLite biomeNoise;
-    FastNoiseLite ridgeNoise;
-    FastNoiseLite mountainNoise;
-    baseNoise.SetFrequency(0.01f);
-    detailNoise.SetFrequency(0.05f);
-    treeNoise.SetFrequency(0.1f);
-    biomeNoise.SetNoiseType(FastNoiseLite::NoiseType_Cellular);
-    biomeNoise.SetFrequency(0.01f);
-    biomeNoise.SetCellularReturnType(FastNoiseLite::CellularReturnType_CellValue);
-    ridgeNoise.SetFractalType(FastNoiseLite::FractalType_Ridged);
-    ridgeNoise.SetFrequency(0.004f);
-    ridgeNoise.SetFractalOctaves(6);
-    mountainNoise.SetFrequency(0.002f);
-    mountainNoise.SetFractalType(FastNoiseLite::FractalType_FBm);
-    mountainNoise.SetFractalOctaves(3);
-    for (int i = 0; i < Chunk::kWidth; i++)
-    for (int j = 0; j < Chunk::kWidth; j++)
+    SDL_assert(tile >= 0 && tile < kTileCount);
+    TerrainNoise noise;
+    int tileX = tile % (kWidth / kTileWidth) * kTileWidth;
+    int tileZ = tile / (kWidth / kTileWidth) * kTileWidth;
+    for (int i = tileX; i < tileX + kTileWidth; i++)
+    for (int j = tileZ; j < tileZ + kTileWidth; j++)
     {
-        Biome biome = BiomeInvalid;
+        ChunkTree& tree = trees[i * kWidth + j];
+        tree.Wood = BlockAir;
         float x = chunkX * Chunk::kWidth + i;
         float z = chunkZ * Chunk::kWidth + j;
-        float ridge = 0.0f;
-        float mountain = (mountainNoise.GetNoise(x, z) + 1.0f) * 0.5f;
-        float detail = (detailNoise.GetNoise(x, z) + 1.0f) * 0.5f;
-        if (mountain > 0.45f + (detail - 0.5f) * 0.05f)
-        {
-            biome = BiomeMountain;
-            float weight = (mountain - 0.45f) / 0.55f;
-            weight = std::pow(weight, 0.8f);
-            ridge = (ridgeNoise.GetNoise(x, z) + 1.0f) * 0.5f * 120.0f * weight;
-        }
-        float base = (baseNoise.GetNoise(x, z) + 1.0f) * 0.5f * 15.0f;
-        int height = base + detail * 4.0f + ridge;
-        height = std::clamp(height, 1, kMaxHeight);
+        float detail;
+        bool mountain;
+        int height = GetHeight(noise, x, z, detail, mountain);
+        Biome biome = mountain ? BiomeMountain : BiomeInvalid;
         if (height < kWaterLevel)
         {
             biome = BiomeOcean;
@@ -110,7 +144,7 @@ void Chunk::Generate(WorldProxy& proxy, int chunkX, int chunkZ)
         }
         else
         {
-            float bv = biomeNoise.GetNoise(x, z);
+            float bv = noise.BiomeNoise.GetNoise(x, z);
             if (bv < -0.7f) biome = BiomeForest;
             else if (bv < -0.4f) biome = BiomeBirchForest;
             else if (bv < -0.1f) biome = BiomeJungle;
@@ -164,7 +198,7 @@ void Chunk::Generate(WorldProxy& proxy, int chunkX, int chunkZ)
                     {
                         continue;
                     }
-                    if (treeNoise.GetNoise(x, z) > 0.4f)
+                    if (noise.TreeNoise.GetNoise(x, z) > 0.4f)
                     {
                         Block wood = BlockAir;
                         Block leaves = BlockAir;
@@ -176,7 +210,10 @@ void Chunk::Generate(WorldProxy& proxy, int chunkX, int chunkZ)
                         else if (biome == BiomeBlueForest) { wood = BlockBlueWood; leaves = BlockBlueLeaves; }
                         SDL_assert(wood != BlockAir);
                         SDL_assert(leaves != BlockAir);
-                        GenerateTree(proxy, i, height, j, wood, leaves, detail);
+                        tree.Y = height;
+                        tree.Offset = 3 + detail * 2.0f;
+                        tree.Wood = wood;
+                        tree.Leaves = leaves;
                     }
                 }
             }
@@ -189,7 +226,69 @@ void Chunk::Generate(WorldProxy& proxy, int chunkX, int chunkZ)
             }
         }
     }
-    Flags &= ~ChunkFlagsGenerate;
+}
+
+void Chunk::Decorate(WorldProxy& proxy, const ChunkTree* trees)
+{
+    SDL_assert(Flags & ChunkFlagsGenerate);
+    // Trees run after every tile so that they only fill air and can't be overwritten by a neighbouring
+    // column, regardless of which thread generated it
+    for (int i = 0; i < kWidth; i++)
+    for (int j = 0; j < kWidth; j++)
+    {
+        const ChunkTree& tree = trees[i * kWidth + j];
+        if (tree.Wood != BlockAir)
+        {
+            GenerateTree(proxy, i, tree.Y, j, tree.Wood, tree.Leaves, tree.Offset);
+        }
+    }
+    Flags &= ~(ChunkFlagsGenerate | ChunkFlagsPreview);
+}
+
+void Chunk::GeneratePreview(WorldProxy& proxy, int chunkX, int chunkZ)
+{
+    SDL_assert(Flags & ChunkFlagsGenerate);
+    static constexpr int kSize = Chunk::kWidth / kPreviewStep;
+    TerrainNoise noise;
+    int heights[kSize + 2][kSize + 2];
+    float details[kSize + 2][kSize + 2];
+    bool mountains[kSize + 2][kSize + 2];
+    for (int i = 0; i < kSize + 2; i++)
+    for (int j = 0; j < kSize + 2; j++)
+    {
+        float x = chunkX * Chunk::kWidth + (i - 1) * kPreviewStep;
+        float z = chunkZ * Chunk::kWidth + (j - 1) * kPreviewStep;
+        heights[i][j] = GetHeight(noise, x, z, details[i][j], mountains[i][j]);
+    }
+    for (int i = 1; i <= kSize; i++)
+    for (int j = 1; j <= kSize; j++)
+    {
+        // Only fill down to the lowest neighbour so that the sides are closed without uploading
+        // the whole column
+        int height = heights[i][j];
+        int bottom = std::min({heights[i - 1][j], heights[i + 1][j], heights[i][j - 1], heights[i][j + 1]});
+        bottom = std::clamp(bottom + 1, 0, height);
+        Block block = BlockGrass;
+        if (height < kWaterLevel)
+        {
+            block = BlockSand;
+        }
+        else if (mountains[i][j] && height > kSnowThreshold + (details[i][j] - 0.5f) * 6.0f)
+        {
+            block = BlockSnow;
+        }
+        else if (mountains[i][j] && height > 35)
+        {
+            block = BlockStone;
+        }
+        for (int x = 0; x < kPreviewStep; x++)
+        for (int z = 0; z < kPreviewStep; z++)
+        for (int y = bottom; y <= height; y++)
+        {
+            proxy.SetBlock({(i - 1) * kPreviewStep + x, y, (j - 1) * kPreviewStep + z}, block);
+        }
+    }
+    Flags |= ChunkFlagsPreview;
 }
 
 void Chunk::AddFlags(ChunkFlags flags)
@@ -197,7 +296,22 @@ void Chunk::AddFlags(ChunkFlags flags)
     Flags |= flags;
 }
 
+void Chunk::RemoveFlags(ChunkFlags flags)
+{
+    Flags &= ~flags;
+}
+
 ChunkFlags Chunk::GetFlags() const
 {
     return Flags;
 }
+
+void Chunk::SetNext(Chunk* next)
+{
+    Next = next;
+}
+
+Chunk* Chunk::GetNext() const
+{
+    return Next;
+}
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 
+#include "block.hpp"
 #include "config.h"
 
 class WorldProxy;
@@ -9,18 +10,38 @@ class WorldProxy;
 using ChunkFlags = uint32_t;
 static constexpr ChunkFlags ChunkFlagsNone = 0;
 static constexpr ChunkFlags ChunkFlagsGenerate = 0x01;
+static constexpr ChunkFlags ChunkFlagsPreview = 0x02;
+static constexpr ChunkFlags ChunkFlagsQueued = 0x04;
+
+struct ChunkTree
+{
+    uint8_t Y;
+    uint8_t Offset;
+    Block Wood;
+    Block Leaves;
+};
 
 class Chunk
 {
 public:
     static constexpr int kWidth = CHUNK_WIDTH;
     static constexpr int kHeight = CHUNK_HEIGHT;
+    static constexpr int kPreviewStep = 4;
+    static constexpr int kTileWidth = 8;
+    static constexpr int kTileCount = (kWidth / kTileWidth) * (kWidth / kTileWidth);
 
     Chunk();
     void Generate(WorldProxy& proxy, int chunkX, int chunkZ);
+    void GenerateTile(WorldProxy& proxy, int chunkX, int chunkZ, int tile, ChunkTree* trees) const;
+    void Decorate(WorldProxy& proxy, const ChunkTree* trees);
+    void GeneratePreview(WorldProxy& proxy, int chunkX, int chunkZ);
     void AddFlags(ChunkFlags flags);
+    void RemoveFlags(ChunkFlags flags);
     ChunkFlags GetFlags() const;
+    void SetNext(Chunk* next);
+    Chunk* GetNext() const;
 
 private:
     ChunkFlags Flags;
+    Chunk* Next;
 };
\ No newline at end of file
@@ -9,22 +9,43 @@
 #define GROUP_SIZE (1 << GROUP_SHIFT)
 #define GROUP_WIDTH ((WORLD_WIDTH * CHUNK_WIDTH) / GROUP_SIZE)
 #define GROUP_HEIGHT (CHUNK_HEIGHT / GROUP_SIZE)
+#define CHUNK_PENDING 0x80
+#define RADIANCE_CACHE_SIZE (1 << 18)
+#define RADIANCE_TRAIN_TILE 4
+#define SUN_CACHE_SIZE (1 << 20)
+#define SUN_CACHE_TEXELS 4
+#define BLUE_NOISE_SIZE 64
+#define TILE_SIZE 8
+#define SORT_BINS (WORLD_WIDTH * WORLD_WIDTH * 8)
+#define BENCHMARK_SAMPLES 1024
 
 #define CLEAR_BLOCKS_THREADS_X 8
 #define CLEAR_BLOCKS_THREADS_Y 8
-#define CLEAR_TEXTURE_THREADS_X 8
-#define CLEAR_TEXTURE_THREADS_Y 8
-#define RAYTRACE_THREADS_X 8
-#define RAYTRACE_THREADS_Y 8
+#define ALLOCATE_THREADS_X 8
+#define ALLOCATE_THREADS_Y 8
+#define ACCUMULATE_THREADS_X 8
+#define ACCUMULATE_THREADS_Y 8
+#define DENOISE_THREADS_X 8
+#define DENOISE_THREADS_Y 8
+#define RAYTRACE_THREADS_X 64
+#define RADIANCE_TRAIN_THREADS_X 8
+#define RADIANCE_TRAIN_THREADS_Y 8
+#define RADIANCE_RESOLVE_THREADS_X 64
+#define RESTIR_THREADS_X 8
+#define RESTIR_THREADS_Y 8
+#define WAVEFRONT_THREADS_X 64
+#define WAVEFRONT_SCAN_THREADS_X 1024
+#define SUN_INVALIDATE_THREADS_X 64
 #define SAMPLE_TEXTURE_THREADS_X 8
 #define SAMPLE_TEXTURE_THREADS_Y 8
+#define UPSCALE_THREADS_X 8
+#define UPSCALE_THREADS_Y 8
+#define TILE_DISTANCE_THREADS_X 8
+#define TILE_DISTANCE_THREADS_Y 8
 #define SET_BLOCKS_THREADS_X 128
 #define SET_CHUNKS_THREADS_X 32
-#define CLEAR_GROUPS_THREADS_X 4
-#define CLEAR_GROUPS_THREADS_Y 16
-#define CLEAR_GROUPS_THREADS_Z 4
-#define UPDATE_GROUPS_THREADS_X 8
-#define UPDATE_GROUPS_THREADS_Y 8
-#define UPDATE_GROUPS_THREADS_Z 8
+#define UPDATE_GROUPS_THREADS_X 4
+#define UPDATE_GROUPS_THREADS_Y 4
+#define UPDATE_GROUPS_THREADS_Z 4
 
 #endif
\ No newline at end of file
@@ -6,6 +6,8 @@
 #include <imgui_impl_sdl3.h>
 #include <imgui_impl_sdlgpu3.h>
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
 
 #include "camera.hpp"
@@ -16,6 +18,17 @@ static constexpr float kSpeed = 0.000000035f;
 static constexpr float kSensitivity = 0.001f;
 static constexpr float kWidth = 1280.0f;
 static constexpr float kRaycast = 10.0f;
+static constexpr float kScaleStep = 0.125f;
+static constexpr uint64_t kScaleInterval = 250000000;
+static constexpr uint64_t kStillInterval = 500000000;
+static constexpr float kFrameTimeSmoothing = 0.1f;
+static constexpr uint64_t kTuneInterval = 1000000000;
+static constexpr float kTuneStepScale = 1.25f;
+static constexpr int kMinSteps = 32;
+static constexpr int kMaxSteps = 2500;
+static constexpr int kMaxBounces = 100;
+static constexpr const char* kSamplers[] = {"Random", "Sobol", "Blue Noise"};
+static constexpr const char* kTonemappers[] = {"None", "Reinhard", "ACES"};
 
 static SDL_Window* window;
 static SDL_GPUDevice* device;
@@ -30,6 +43,17 @@ static float dt;
 static WorldQuery worldQuery;
 static WorldOptions worldOptions;
 static Block block = BlockWhiteLight;
+static bool dynamicResolution = false;
+static float targetFrameTime = 16.6f;
+static float minScale = 0.5f;
+static float maxScale = 1.0f;
+static float scale = 1.0f;
+static float frameTime;
+static uint64_t scaleTime;
+static uint64_t moveTime;
+static bool autoTune = false;
+static float maxTruncation = 0.01f;
+static uint64_t tuneTime;
 
 static bool Init()
 {
@@ -246,10 +270,94 @@ static void Update()
     world.Update(camera);
 }
 
+// Resizing reallocates the render targets and blurs the resampled history so the scale only moves in steps and not too often
+static float UpdateScale()
+{
+    frameTime += (dt / 1000000.0f - frameTime) * kFrameTimeSmoothing;
+    if (camera.GetDirty())
+    {
+        moveTime = time2;
+    }
+    if (!dynamicResolution || time2 - moveTime >= kStillInterval)
+    {
+        return maxScale;
+    }
+    if (time2 - scaleTime < kScaleInterval)
+    {
+        return scale;
+    }
+    if (frameTime > targetFrameTime)
+    {
+        return std::max(minScale, scale - kScaleStep);
+    }
+    if (frameTime < targetFrameTime * 0.75f)
+    {
+        return std::min(maxScale, scale + kScaleStep);
+    }
+    return scale;
+}
+
+// Changing either limit drops the history so they only move once in a while. A limit is raised while it
+// cuts short more paths than allowed and there's frame time to spare, and the one furthest under the
+// threshold is lowered when over the target frame time
+static void UpdateLimits()
+{
+    if (!autoTune || time2 - tuneTime < kTuneInterval)
+    {
+        return;
+    }
+    // The dynamic resolution chases the same frame time so the limits wait until it has settled
+    if (scale != maxScale || time2 - scaleTime < kTuneInterval)
+    {
+        return;
+    }
+    const WorldStats& stats = world.GetStats();
+    if (stats.Paths == 0)
+    {
+        return;
+    }
+    float stepRate = float(stats.StepLimit) / stats.Paths;
+    float bounceRate = float(stats.BounceLimit) / stats.Paths;
+    int maxSteps = worldOptions.MaxSteps;
+    int maxBounces = worldOptions.MaxBounces;
+    if (frameTime > targetFrameTime)
+    {
+        bool lowerSteps = stepRate < maxTruncation * 0.5f;
+        bool lowerBounces = bounceRate < maxTruncation * 0.5f;
+        if (lowerSteps && (!lowerBounces || stepRate <= bounceRate))
+        {
+            maxSteps = std::max(kMinSteps, int(maxSteps / kTuneStepScale));
+        }
+        else if (lowerBounces)
+        {
+            maxBounces = std::max(1, maxBounces - 1);
+        }
+    }
+    else
+    {
+        if (stepRate > maxTruncation)
+        {
+            maxSteps = std::min(kMaxSteps, std::max(maxSteps + 1, int(maxSteps * kTuneStepScale)));
+        }
+        if (bounceRate > maxTruncation)
+        {
+            maxBounces = std::min(kMaxBounces, maxBounces + 1);
+        }
+    }
+    if (maxSteps != worldOptions.MaxSteps || maxBounces != worldOptions.MaxBounces)
+    {
+        worldOptions.MaxSteps = maxSteps;
+        worldOptions.MaxBounces = maxBounces;
+        world.SetOptions(worldOptions);
+        tuneTime = time2;
+    }
+}
+
 static bool Resize(uint32_t width, uint32_t height)
 {
     float aspectRatio = float(width) / float(height);
-    camera.Resize(kWidth, kWidth / aspectRatio);
+    float scaledWidth = std::round(kWidth * scale);
+    camera.Resize(scaledWidth, scaledWidth / aspectRatio);
     SDL_ReleaseGPUTexture(device, colorTexture);
     SDL_GPUTextureCreateInfo info{};
     info.format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
@@ -293,7 +401,15 @@ static void Render()
         SDL_SubmitGPUCommandBuffer(commandBuffer);
         return;
     }
-    if ((textureWidth != width || textureHeight != height) && !Resize(width, height))
+    UpdateLimits();
+    float newScale = UpdateScale();
+    bool rescale = newScale != scale;
+    if (rescale)
+    {
+        scale = newScale;
+        scaleTime = time2;
+    }
+    if ((textureWidth != width || textureHeight != height || rescale) && !Resize(width, height))
     {
         SDL_Log("Failed to create color texture: %s", SDL_GetError());
         SDL_SubmitGPUCommandBuffer(commandBuffer);
@@ -325,6 +441,12 @@ static void Render()
         ImGui::Text("GPU: %s", SDL_GetStringProperty(SDL_GetGPUDeviceProperties(device), SDL_PROP_GPU_DEVICE_NAME_STRING, "?"));
         ImGui::Text("Driver: %s", SDL_GetGPUDeviceDriver(device));
         ImGui::Text("Delta Time: %f ms", dt / 1000000.0f);
+        ImGui::Text("Resolution: %d x %d", camera.GetWidth(), camera.GetHeight());
+        ImGui::Checkbox("Dynamic Resolution", &dynamicResolution);
+        ImGui::SliderFloat("Target Frame Time", &targetFrameTime, 4.0f, 50.0f, "%.1f ms");
+        ImGui::SliderFloat("Min Scale", &minScale, 0.25f, 1.0f);
+        ImGui::SliderFloat("Max Scale", &maxScale, 0.25f, 1.0f);
+        minScale = std::min(minScale, maxScale);
         if (ImGui::Combo("Block", &value, BlockGetStrings() + BlockFirst, BlockCount - BlockFirst))
         {
             block = Block(value + BlockFirst);
@@ -334,19 +456,88 @@ static void Render()
         bool setOptions = false;
         int maxSteps = worldOptions.MaxSteps;
         int maxBounces = worldOptions.MaxBounces;
-        setOptions |= ImGui::SliderInt("Max Steps", &maxSteps, 0, 2500);
-        setOptions |= ImGui::SliderInt("Max Bounces", &maxBounces, 0, 100);
+        int maxHistory = worldOptions.MaxHistory;
+        int denoiseIterations = worldOptions.DenoiseIterations;
+        int upscaleFactor = worldOptions.UpscaleFactor;
+        int sampler = worldOptions.Sampler;
+        int retraceInterval = worldOptions.RetraceInterval;
+        bool raySorting = worldOptions.RaySorting;
+        bool halfAccumulation = worldOptions.HalfAccumulation;
+        bool foveated = worldOptions.Foveated;
+        int tonemapper = worldOptions.Tonemapper;
+        bool temporal = worldOptions.Temporal;
+        bool wavefront = worldOptions.Wavefront;
+        bool restir = worldOptions.Restir;
+        bool radianceCache = worldOptions.RadianceCache;
+        bool sunCache = worldOptions.SunCache;
+        setOptions |= ImGui::SliderInt("Max Steps", &maxSteps, 0, kMaxSteps);
+        setOptions |= ImGui::SliderInt("Max Bounces", &maxBounces, 0, kMaxBounces);
+        ImGui::Checkbox("Auto Tune", &autoTune);
+        ImGui::SliderFloat("Max Truncation", &maxTruncation, 0.0f, 0.1f, "%.3f");
+        const WorldStats& stats = world.GetStats();
+        float paths = std::max(stats.Paths, 1u);
+        ImGui::Text("Step Limited: %.2f%%", stats.StepLimit / paths * 100.0f);
+        ImGui::Text("Bounce Limited: %.2f%%", stats.BounceLimit / paths * 100.0f);
         setOptions |= ImGui::ColorEdit3("Sky Bottom", glm::value_ptr(worldOptions.SkyBottom));
         setOptions |= ImGui::ColorEdit3("Sky Top", glm::value_ptr(worldOptions.SkyTop));
         setOptions |= ImGui::SliderFloat("Time of Day", &worldOptions.TimeOfDay, 0.0f, 24.0f, "%.2f h");
         setOptions |= ImGui::ColorEdit3("Sun Color", glm::value_ptr(worldOptions.SunColor));
         setOptions |= ImGui::SliderFloat("Sun Intensity", &worldOptions.SunIntensity, 0.0f, 20.0f);
+        float hysteresis = world.GetHysteresis();
+        if (ImGui::SliderFloat("Hysteresis", &hysteresis, 0.0f, Chunk::kWidth))
+        {
+            world.SetHysteresis(hysteresis);
+        }
+        setOptions |= ImGui::Checkbox("Wavefront", &wavefront);
+        setOptions |= ImGui::Checkbox("Ray Sorting", &raySorting);
+        setOptions |= ImGui::Checkbox("Temporal", &temporal);
+        setOptions |= ImGui::Checkbox("ReSTIR", &restir);
+        setOptions |= ImGui::Checkbox("Radiance Cache", &radianceCache);
+        setOptions |= ImGui::Checkbox("Sun Cache", &sunCache);
+        setOptions |= ImGui::SliderInt("Max History", &maxHistory, 1, 256);
+        setOptions |= ImGui::Checkbox("Half Accumulation", &halfAccumulation);
+        setOptions |= ImGui::SliderInt("Denoise Iterations", &denoiseIterations, 0, 5);
+        setOptions |= ImGui::SliderInt("Upscale Factor", &upscaleFactor, 1, 4);
+        setOptions |= ImGui::Combo("Sampler", &sampler, kSamplers, SDL_arraysize(kSamplers));
+        setOptions |= ImGui::SliderInt("Retrace Interval", &retraceInterval, 1, 16);
+        setOptions |= ImGui::Checkbox("Foveated", &foveated);
+        setOptions |= ImGui::SliderFloat("Fovea Radius", &worldOptions.FoveaRadius, 0.0f, 1.0f);
+        setOptions |= ImGui::SliderFloat("Adaptive Threshold", &worldOptions.AdaptiveThreshold, 0.0f, 0.1f);
+        setOptions |= ImGui::SliderFloat("Edit Radius", &worldOptions.EditRadius, 0.0f, 32.0f);
+        setOptions |= ImGui::SliderFloat("Exposure", &worldOptions.Exposure, -4.0f, 4.0f, "%.1f EV");
+        setOptions |= ImGui::Combo("Tonemapper", &tonemapper, kTonemappers, SDL_arraysize(kTonemappers));
         worldOptions.MaxSteps = maxSteps;
         worldOptions.MaxBounces = maxBounces;
+        worldOptions.MaxHistory = maxHistory;
+        worldOptions.Temporal = temporal;
+        worldOptions.Wavefront = wavefront;
+        worldOptions.Restir = restir;
+        worldOptions.RadianceCache = radianceCache;
+        worldOptions.SunCache = sunCache;
+        worldOptions.DenoiseIterations = denoiseIterations;
+        worldOptions.UpscaleFactor = upscaleFactor;
+        worldOptions.Sampler = sampler;
+        worldOptions.RetraceInterval = retraceInterval;
+        worldOptions.RaySorting = raySorting;
+        worldOptions.HalfAccumulation = halfAccumulation;
+        worldOptions.Foveated = foveated;
+        worldOptions.Tonemapper = tonemapper;
         if (setOptions)
         {
             world.SetOptions(worldOptions);
         }
+        // Results are logged against the sample count
+        if (ImGui::Button("Capture Reference"))
+        {
+            world.CaptureReference();
+        }
+        ImGui::SameLine();
+        ImGui::BeginDisabled(!world.HasReference());
+        if (ImGui::Button("Benchmark"))
+        {
+            world.StartBenchmark();
+        }
+        ImGui::EndDisabled();
         ImGui::EndDisabled();
         ImGui::Render();
         ImGui_ImplSDLGPU3_PrepareDrawData(ImGui::GetDrawData(), commandBuffer);
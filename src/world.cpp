@@ -8,8 +8,9 @@
 #include <cstring>
 #include <execution>
 #include <numeric>
+#include <random>
+#include <bitset>
 #include <thread>
-#include <unordered_set>
 #include <vector>
 
 #include "block.hpp"
@@ -36,6 +37,119 @@ static void TestFloorChunkIndex()
     SDL_assert(FloorChunkIndex(-Chunk::kWidth - 1) == -2);
 }
 
+static float HalfToFloat(uint16_t value)
+{
+    uint32_t sign = (value & 0x8000u) << 16;
+    uint32_t exponent = (value >> 10) & 0x1Fu;
+    uint32_t mantissa = value & 0x3FFu;
+    if (exponent == 0)
+    {
+        float result = std::ldexp(float(mantissa), -24);
+        return sign ? -result : result;
+    }
+    uint32_t bits;
+    if (exponent == 31)
+    {
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    }
+    else
+    {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+// Ranks from the void and cluster method, normalized to [0, 1)
+// https://cv.ulichney.com/papers/1993-void-cluster.pdf
+static std::vector<float> GetBlueNoise()
+{
+    static constexpr int kSize = BLUE_NOISE_SIZE;
+    static constexpr int kCount = kSize * kSize;
+    static constexpr float kSigma = 1.5f;
+    std::vector<float> kernel(kCount);
+    for (int x = 0; x < kSize; x++)
+    for (int y = 0; y < kSize; y++)
+    {
+        float dx = std::min(x, kSize - x);
+        float dy = std::min(y, kSize - y);
+        kernel[x + y * kSize] = std::exp(-(dx * dx + dy * dy) / (2.0f * kSigma * kSigma));
+    }
+    std::vector<bool> pattern(kCount);
+    std::vector<float> energy(kCount);
+    auto toggle = [&](int index)
+    {
+        pattern[index] = !pattern[index];
+        float sign = pattern[index] ? 1.0f : -1.0f;
+        int indexX = index % kSize;
+        int indexY = index / kSize;
+        for (int x = 0; x < kSize; x++)
+        for (int y = 0; y < kSize; y++)
+        {
+            energy[(indexX + x) % kSize + (indexY + y) % kSize * kSize] += sign * kernel[x + y * kSize];
+        }
+    };
+    // Tightest cluster among the set pixels or largest void among the others
+    auto find = [&](bool value)
+    {
+        int best = -1;
+        for (int i = 0; i < kCount; i++)
+        {
+            if (pattern[i] == value && (best == -1 || (value ? energy[i] > energy[best] : energy[i] < energy[best])))
+            {
+                best = i;
+            }
+        }
+        return best;
+    };
+    std::mt19937 random{0};
+    int ones = kCount / 10;
+    for (int i = 0; i < ones; i++)
+    {
+        int index;
+        do
+        {
+            index = random() % kCount;
+        }
+        while (pattern[index]);
+        toggle(index);
+    }
+    while (true)
+    {
+        int cluster = find(true);
+        toggle(cluster);
+        int hole = find(false);
+        toggle(hole);
+        if (hole == cluster)
+        {
+            break;
+        }
+    }
+    std::vector<bool> initialPattern = pattern;
+    std::vector<float> initialEnergy = energy;
+    std::vector<float> noise(kCount);
+    for (int rank = ones - 1; rank >= 0; rank--)
+    {
+        int cluster = find(true);
+        toggle(cluster);
+        noise[cluster] = rank;
+    }
+    pattern = initialPattern;
+    energy = initialEnergy;
+    for (int rank = ones; rank < kCount; rank++)
+    {
+        int hole = find(false);
+        toggle(hole);
+        noise[hole] = rank;
+    }
+    for (float& value : noise)
+    {
+        value = (value + 0.5f) / kCount;
+    }
+    return noise;
+}
+
 WorldSetBlockJob::WorldSetBlockJob(const glm::ivec3& position, Block block)
     : X(position.x)
     , Y(position.y)
@@ -61,6 +175,24 @@ WorldOptions::WorldOptions()
     , SunIntensity{3.0f}
     , SunDirection{0.0f, 1.0f, 0.0f}
     , TimeOfDay{10.0f}
+    , Temporal{1}
+    , MaxHistory{32}
+    , DenoiseIterations{0}
+    , EditRadius{4.0f}
+    , Wavefront{0}
+    , Restir{0}
+    , RadianceCache{0}
+    , SunCache{0}
+    , AdaptiveThreshold{0.0f}
+    , UpscaleFactor{1}
+    , Sampler{0}
+    , RetraceInterval{8}
+    , RaySorting{1}
+    , HalfAccumulation{0}
+    , Exposure{0.0f}
+    , Tonemapper{0}
+    , Foveated{0}
+    , FoveaRadius{0.45f}
 {
 }
 
@@ -69,6 +201,10 @@ WorldProxy::WorldProxy(World& handle, DynamicBuffer<WorldSetBlockJob>& buffer, i
     , Buffer{buffer}
     , X{chunkX * Chunk::kWidth}
     , Z{chunkZ * Chunk::kWidth}
+{
+}
+
+void WorldProxy::Clear()
 {
     for (int i = 0; i < Chunk::kWidth; i++)
     for (int j = 0; j < Chunk::kWidth; j++)
@@ -92,34 +228,124 @@ void WorldProxy::SetBlock(glm::ivec3 position, Block block)
     Buffer.Emplace(Handle.Device, position, block);
 }
 
+Block WorldProxy::GetBlock(glm::ivec3 position) const
+{
+    SDL_assert(position.x >= 0 && position.x < Chunk::kWidth);
+    SDL_assert(position.y >= 0 && position.y < Chunk::kHeight);
+    SDL_assert(position.z >= 0 && position.z < Chunk::kWidth);
+    return Handle.Blocks[position.x + X][position.y][position.z + Z];
+}
+
 World::World()
     : Device{nullptr}
     , Blocks{}
     , Chunks{}
     , ChunkMap{}
+    , Cache{}
+    , CacheTime{0}
     , SetBlocksBuffers{}
     , SetBlocksBufferCount{0}
+    , Trees{}
+    , PendingChunks{nullptr}
+    , InverseChunkMap{}
+    , Jobs{}
+    , JobIndices{}
+    , CacheIndices{}
+    , JobsCapacity{0}
+    , OutOfBoundsCapacity{0}
+    , ClearCapacity{0}
+    , OutOfBoundsChunks{}
     , UpdateGroups{}
     , SetChunksBuffer{}
     , ClearChunks{}
     , WorldStateBuffer{}
+    , Hysteresis{8.0f}
     , BlockStateBuffer{}
+    , PreviousCameraBuffer{}
+    , EditsBuffer{}
+    , EditCount{0}
+    , Lights{}
+    , LightsBuffer{}
+    , LightsDirty{false}
+    , PathBuffers{}
+    , HitBuffer{nullptr}
+    , ShadowBuffer{nullptr}
+    , CounterBuffer{nullptr}
+    , ArgsBuffer{nullptr}
+    , ReservoirBuffers{}
+    , SurfaceBuffers{}
+    , CandidateBuffer{nullptr}
+    , RadianceCacheBuffer{nullptr}
+    , SunCacheBuffer{nullptr}
+    , PixelBuffer{nullptr}
+    , PixelArgsBuffer{nullptr}
+    , PrimaryBuffer{nullptr}
+    , SortBuffer{nullptr}
+    , OrderBuffer{nullptr}
+    , StatsBuffer{nullptr}
     , BlockTexture{nullptr}
     , GroupTexture{nullptr}
     , ChunkTexture{nullptr}
-    , ColorTexture{nullptr}
+    , BlueNoiseTexture{nullptr}
+    , SampleTexture{nullptr}
+    , ColorTextures{}
+    , FeatureTexture{nullptr}
+    , MomentTextures{}
+    , DenoiseTextures{}
+    , UpscaleTextures{}
+    , TileTexture{nullptr}
     , SetBlocksPipeline{nullptr}
     , SetChunksPipeline{nullptr}
     , ClearBlocksPipeline{nullptr}
     , RaytracePipeline{nullptr}
-    , ClearTexturePipeline{nullptr}
+    , AccumulatePipeline{nullptr}
+    , AccumulateHalfPipeline{nullptr}
+    , DenoisePipeline{nullptr}
     , SampleTexturePipeline{nullptr}
-    , ClearGroupsPipeline{nullptr}
     , SetGroupsPipeline{nullptr}
+    , WavefrontGeneratePipeline{nullptr}
+    , WavefrontPreparePipeline{nullptr}
+    , WavefrontExtendPipeline{nullptr}
+    , WavefrontShadePipeline{nullptr}
+    , WavefrontShadowPipeline{nullptr}
+    , WavefrontBinPipeline{nullptr}
+    , WavefrontScanPipeline{nullptr}
+    , WavefrontSortPipeline{nullptr}
+    , RestirInitialPipeline{nullptr}
+    , RestirSpatialPipeline{nullptr}
+    , RadianceTrainPipeline{nullptr}
+    , RadianceResolvePipeline{nullptr}
+    , SunInvalidatePipeline{nullptr}
+    , AllocatePipeline{nullptr}
+    , AllocatePreparePipeline{nullptr}
+    , UpscalePipeline{nullptr}
+    , TileDistancePipeline{nullptr}
     , Width{0}
     , Height{0}
+    , OutputWidth{0}
+    , OutputHeight{0}
+    , ColorFormat{SDL_GPU_TEXTUREFORMAT_INVALID}
     , Dirty{true}
+    , SunDirty{true}
+    , RadianceDirty{true}
     , Sample{0}
+    , StillFrames{0}
+    , History{0}
+    , ReservoirHistory{0}
+    , UpscaleHistory{0}
+    , Reference{}
+    , ReferenceWidth{0}
+    , ReferenceHeight{0}
+    , DownloadBuffers{}
+    , DownloadSize{0}
+    , DownloadFrames{}
+    , DownloadHalf{false}
+    , CaptureRequested{false}
+    , BenchmarkSample{-1}
+    , BenchmarkThreshold{0.0f}
+    , StatsDownloadBuffers{}
+    , StatsFrame{0}
+    , Stats{}
 {
 }
 
@@ -133,6 +359,17 @@ bool World::Init(SDL_GPUDevice* device)
 #else
     SetBlocksBuffers.resize(1);
 #endif
+    Trees.resize(SetBlocksBuffers.size() * Chunk::kWidth * Chunk::kWidth);
+    // Sized up front so that World::Update never allocates
+    Jobs.reserve(kWidth * kWidth);
+    JobIndices.resize(SetBlocksBuffers.size());
+    std::iota(JobIndices.begin(), JobIndices.end(), 0);
+    CacheIndices.resize(kWidth * kWidth);
+    OutOfBoundsChunks.reserve(kWidth * kWidth);
+    ClearChunks.reserve(kWidth * kWidth);
+    JobsCapacity = Jobs.capacity();
+    OutOfBoundsCapacity = OutOfBoundsChunks.capacity();
+    ClearCapacity = ClearChunks.capacity();
     {
         SDL_GPUTextureCreateInfo info{};
         info.format = SDL_GPU_TEXTUREFORMAT_R8_UINT;
@@ -170,6 +407,66 @@ bool World::Init(SDL_GPUDevice* device)
             SDL_Log("Failed to create group texture: %s", SDL_GetError());
             return false;
         }
+        info.format = SDL_GPU_TEXTUREFORMAT_R32_FLOAT;
+        info.type = SDL_GPU_TEXTURETYPE_2D;
+        info.usage = SDL_GPU_TEXTUREUSAGE_COMPUTE_STORAGE_READ;
+        info.width = BLUE_NOISE_SIZE;
+        info.height = BLUE_NOISE_SIZE;
+        info.layer_count_or_depth = 1;
+        BlueNoiseTexture = SDL_CreateGPUTexture(Device, &info);
+        if (!BlueNoiseTexture)
+        {
+            SDL_Log("Failed to create blue noise texture: %s", SDL_GetError());
+            return false;
+        }
+    }
+    {
+        // Cleared on the first frame since the world starts dirty
+        SDL_GPUBufferCreateInfo info{};
+        info.usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE;
+        info.size = RADIANCE_CACHE_SIZE * sizeof(RadianceCell);
+        RadianceCacheBuffer = SDL_CreateGPUBuffer(Device, &info);
+        if (!RadianceCacheBuffer)
+        {
+            SDL_Log("Failed to create radiance cache buffer: %s", SDL_GetError());
+            return false;
+        }
+        info.size = SUN_CACHE_SIZE * sizeof(SunCell);
+        SunCacheBuffer = SDL_CreateGPUBuffer(Device, &info);
+        if (!SunCacheBuffer)
+        {
+            SDL_Log("Failed to create sun cache buffer: %s", SDL_GetError());
+            return false;
+        }
+        // Zeroed once on upload since the scan clears the counts after every use
+        info.size = 2 * SORT_BINS * sizeof(uint32_t);
+        SortBuffer = SDL_CreateGPUBuffer(Device, &info);
+        if (!SortBuffer)
+        {
+            SDL_Log("Failed to create sort buffer: %s", SDL_GetError());
+            return false;
+        }
+        info.size = sizeof(WorldStats);
+        StatsBuffer = SDL_CreateGPUBuffer(Device, &info);
+        if (!StatsBuffer)
+        {
+            SDL_Log("Failed to create stats buffer: %s", SDL_GetError());
+            return false;
+        }
+    }
+    // Read a few frames late so that mapping them never waits on the GPU
+    for (int i = 0; i < kStatsLatency; i++)
+    {
+        SDL_GPUTransferBufferCreateInfo info{};
+        info.usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD;
+        info.size = sizeof(WorldStats);
+        StatsDownloadBuffers[i] = SDL_CreateGPUTransferBuffer(Device, &info);
+        if (!StatsDownloadBuffers[i])
+        {
+            SDL_Log("Failed to create stats transfer buffer: %s", SDL_GetError());
+            return false;
+        }
+        DownloadFrames[i] = -1;
     }
     {
         SetBlocksPipeline = LoadComputePipeline(Device, "set_blocks.comp");
@@ -196,22 +493,28 @@ bool World::Init(SDL_GPUDevice* device)
             SDL_Log("Failed to load raytrace pipeline");
             return false;
         }
-        ClearTexturePipeline = LoadComputePipeline(Device, "clear_texture.comp");
-        if (!ClearTexturePipeline)
+        AccumulatePipeline = LoadComputePipeline(Device, "accumulate.comp");
+        if (!AccumulatePipeline)
         {
-            SDL_Log("Failed to load clear texture pipeline");
+            SDL_Log("Failed to load accumulate pipeline");
             return false;
         }
-        SampleTexturePipeline = LoadComputePipeline(Device, "sample_texture.comp");
-        if (!SampleTexturePipeline)
+        AccumulateHalfPipeline = LoadComputePipeline(Device, "accumulate_half.comp");
+        if (!AccumulateHalfPipeline)
         {
-            SDL_Log("Failed to load sample texture pipeline");
+            SDL_Log("Failed to load accumulate half pipeline");
+            return false;
+        }
+        DenoisePipeline = LoadComputePipeline(Device, "denoise.comp");
+        if (!DenoisePipeline)
+        {
+            SDL_Log("Failed to load denoise pipeline");
             return false;
         }
-        ClearGroupsPipeline = LoadComputePipeline(Device, "clear_groups.comp");
-        if (!ClearGroupsPipeline)
+        SampleTexturePipeline = LoadComputePipeline(Device, "sample_texture.comp");
+        if (!SampleTexturePipeline)
         {
-            SDL_Log("Failed to load clear groups pipeline");
+            SDL_Log("Failed to load sample texture pipeline");
             return false;
         }
         SetGroupsPipeline = LoadComputePipeline(Device, "set_groups.comp");
@@ -220,6 +523,108 @@ bool World::Init(SDL_GPUDevice* device)
             SDL_Log("Failed to load set groups pipeline");
             return false;
         }
+        WavefrontGeneratePipeline = LoadComputePipeline(Device, "wavefront_generate.comp");
+        if (!WavefrontGeneratePipeline)
+        {
+            SDL_Log("Failed to load wavefront generate pipeline");
+            return false;
+        }
+        WavefrontPreparePipeline = LoadComputePipeline(Device, "wavefront_prepare.comp");
+        if (!WavefrontPreparePipeline)
+        {
+            SDL_Log("Failed to load wavefront prepare pipeline");
+            return false;
+        }
+        WavefrontExtendPipeline = LoadComputePipeline(Device, "wavefront_extend.comp");
+        if (!WavefrontExtendPipeline)
+        {
+            SDL_Log("Failed to load wavefront extend pipeline");
+            return false;
+        }
+        WavefrontShadePipeline = LoadComputePipeline(Device, "wavefront_shade.comp");
+        if (!WavefrontShadePipeline)
+        {
+            SDL_Log("Failed to load wavefront shade pipeline");
+            return false;
+        }
+        WavefrontShadowPipeline = LoadComputePipeline(Device, "wavefront_shadow.comp");
+        if (!WavefrontShadowPipeline)
+        {
+            SDL_Log("Failed to load wavefront shadow pipeline");
+            return false;
+        }
+        WavefrontBinPipeline = LoadComputePipeline(Device, "wavefront_bin.comp");
+        if (!WavefrontBinPipeline)
+        {
+            SDL_Log("Failed to load wavefront bin pipeline");
+            return false;
+        }
+        WavefrontScanPipeline = LoadComputePipeline(Device, "wavefront_scan.comp");
+        if (!WavefrontScanPipeline)
+        {
+            SDL_Log("Failed to load wavefront scan pipeline");
+            return false;
+        }
+        WavefrontSortPipeline = LoadComputePipeline(Device, "wavefront_sort.comp");
+        if (!WavefrontSortPipeline)
+        {
+            SDL_Log("Failed to load wavefront sort pipeline");
+            return false;
+        }
+        RestirInitialPipeline = LoadComputePipeline(Device, "restir_initial.comp");
+        if (!RestirInitialPipeline)
+        {
+            SDL_Log("Failed to load restir initial pipeline");
+            return false;
+        }
+        RestirSpatialPipeline = LoadComputePipeline(Device, "restir_spatial.comp");
+        if (!RestirSpatialPipeline)
+        {
+            SDL_Log("Failed to load restir spatial pipeline");
+            return false;
+        }
+        RadianceTrainPipeline = LoadComputePipeline(Device, "radiance_train.comp");
+        if (!RadianceTrainPipeline)
+        {
+            SDL_Log("Failed to load radiance train pipeline");
+            return false;
+        }
+        RadianceResolvePipeline = LoadComputePipeline(Device, "radiance_resolve.comp");
+        if (!RadianceResolvePipeline)
+        {
+            SDL_Log("Failed to load radiance resolve pipeline");
+            return false;
+        }
+        SunInvalidatePipeline = LoadComputePipeline(Device, "sun_invalidate.comp");
+        if (!SunInvalidatePipeline)
+        {
+            SDL_Log("Failed to load sun invalidate pipeline");
+            return false;
+        }
+        AllocatePipeline = LoadComputePipeline(Device, "allocate.comp");
+        if (!AllocatePipeline)
+        {
+            SDL_Log("Failed to load allocate pipeline");
+            return false;
+        }
+        AllocatePreparePipeline = LoadComputePipeline(Device, "allocate_prepare.comp");
+        if (!AllocatePreparePipeline)
+        {
+            SDL_Log("Failed to load allocate prepare pipeline");
+            return false;
+        }
+        UpscalePipeline = LoadComputePipeline(Device, "upscale.comp");
+        if (!UpscalePipeline)
+        {
+            SDL_Log("Failed to load upscale pipeline");
+            return false;
+        }
+        TileDistancePipeline = LoadComputePipeline(Device, "tile_distance.comp");
+        if (!TileDistancePipeline)
+        {
+            SDL_Log("Failed to load tile distance pipeline");
+            return false;
+        }
     }
     {
         if (!WorldStateBuffer.Init(Device))
@@ -232,22 +637,81 @@ bool World::Init(SDL_GPUDevice* device)
             SDL_Log("Failed to initialize block state");
             return false;
         }
+        if (!PreviousCameraBuffer.Init(Device))
+        {
+            SDL_Log("Failed to initialize previous camera state");
+            return false;
+        }
+        // Creates the buffer up front so that there's always something to bind
+        EditsBuffer.Emplace(Device, 0, 0, 0, 0);
+        EditsBuffer.Upload(Device);
+        LightsBuffer.Emplace(Device, 0, 0, 0, 0);
+        LightsBuffer.Upload(Device);
         BlockStateBuffer.Get() = BlockGetState();
         WorldStateBuffer.Get().X = 0;
         WorldStateBuffer.Get().Z = 0;
         for (int x = 0; x < kWidth; x++)
         for (int z = 0; z < kWidth; z++)
         {
-            Chunks[x][z].AddFlags(ChunkFlagsGenerate);
+            QueueChunk(x, z);
             ChunkMap[x][z] = {x, z};
-            SetChunksBuffer.Emplace(device, x, z, x, z);
+            InverseChunkMap[x][z] = {x, z};
+            SetChunk(x, z);
+        }
+        std::vector<float> blueNoise = GetBlueNoise();
+        SDL_GPUTransferBufferCreateInfo info{};
+        info.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
+        uint32_t blueNoiseSize = blueNoise.size() * sizeof(float);
+        uint32_t sortSize = 2 * SORT_BINS * sizeof(uint32_t);
+        info.size = blueNoiseSize + sortSize;
+        SDL_GPUTransferBuffer* transferBuffer = SDL_CreateGPUTransferBuffer(Device, &info);
+        if (!transferBuffer)
+        {
+            SDL_Log("Failed to create transfer buffer: %s", SDL_GetError());
+            return false;
         }
+        void* data = SDL_MapGPUTransferBuffer(Device, transferBuffer, false);
+        if (!data)
+        {
+            SDL_Log("Failed to map transfer buffer: %s", SDL_GetError());
+            SDL_ReleaseGPUTransferBuffer(Device, transferBuffer);
+            return false;
+        }
+        std::memcpy(data, blueNoise.data(), blueNoiseSize);
+        std::memset(static_cast<uint8_t*>(data) + blueNoiseSize, 0, sortSize);
+        SDL_UnmapGPUTransferBuffer(Device, transferBuffer);
         SDL_GPUCommandBuffer* commandBuffer = SDL_AcquireGPUCommandBuffer(device);
         if (!commandBuffer)
         {
             SDL_Log("Failed to acquire command buffer: %s", SDL_GetError());
+            SDL_ReleaseGPUTransferBuffer(Device, transferBuffer);
+            return false;
+        }
+        SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(commandBuffer);
+        if (!copyPass)
+        {
+            SDL_Log("Failed to begin copy pass: %s", SDL_GetError());
+            SDL_ReleaseGPUTransferBuffer(Device, transferBuffer);
+            SDL_CancelGPUCommandBuffer(commandBuffer);
             return false;
         }
+        SDL_GPUTextureTransferInfo source{};
+        SDL_GPUTextureRegion destination{};
+        source.transfer_buffer = transferBuffer;
+        destination.texture = BlueNoiseTexture;
+        destination.w = BLUE_NOISE_SIZE;
+        destination.h = BLUE_NOISE_SIZE;
+        destination.d = 1;
+        SDL_UploadToGPUTexture(copyPass, &source, &destination, false);
+        SDL_GPUTransferBufferLocation sortSource{};
+        SDL_GPUBufferRegion sortDestination{};
+        sortSource.transfer_buffer = transferBuffer;
+        sortSource.offset = blueNoiseSize;
+        sortDestination.buffer = SortBuffer;
+        sortDestination.size = sortSize;
+        SDL_UploadToGPUBuffer(copyPass, &sortSource, &sortDestination, false);
+        SDL_EndGPUCopyPass(copyPass);
+        SDL_ReleaseGPUTransferBuffer(Device, transferBuffer);
         Dispatch(commandBuffer);
         SDL_SubmitGPUCommandBuffer(commandBuffer);
     }
@@ -256,6 +720,9 @@ bool World::Init(SDL_GPUDevice* device)
 
 void World::Destroy()
 {
+    EditsBuffer.Destroy(Device);
+    LightsBuffer.Destroy(Device);
+    PreviousCameraBuffer.Destroy(Device);
     BlockStateBuffer.Destroy(Device);
     WorldStateBuffer.Destroy(Device);
     SetChunksBuffer.Destroy(Device);
@@ -264,33 +731,100 @@ void World::Destroy()
         SetBlocksBuffers[i].Destroy(Device);
     }
     SDL_ReleaseGPUComputePipeline(Device, SampleTexturePipeline);
-    SDL_ReleaseGPUComputePipeline(Device, ClearTexturePipeline);
+    SDL_ReleaseGPUComputePipeline(Device, AccumulatePipeline);
+    SDL_ReleaseGPUComputePipeline(Device, AccumulateHalfPipeline);
+    SDL_ReleaseGPUComputePipeline(Device, DenoisePipeline);
     SDL_ReleaseGPUComputePipeline(Device, RaytracePipeline);
     SDL_ReleaseGPUComputePipeline(Device, SetBlocksPipeline);
     SDL_ReleaseGPUComputePipeline(Device, SetChunksPipeline);
     SDL_ReleaseGPUComputePipeline(Device, ClearBlocksPipeline);
-    SDL_ReleaseGPUComputePipeline(Device, ClearGroupsPipeline);
     SDL_ReleaseGPUComputePipeline(Device, SetGroupsPipeline);
+    SDL_ReleaseGPUComputePipeline(Device, WavefrontGeneratePipeline);
+    SDL_ReleaseGPUComputePipeline(Device, WavefrontPreparePipeline);
+    SDL_ReleaseGPUComputePipeline(Device, WavefrontExtendPipeline);
+    SDL_ReleaseGPUComputePipeline(Device, WavefrontShadePipeline);
+    SDL_ReleaseGPUComputePipeline(Device, WavefrontShadowPipeline);
+    SDL_ReleaseGPUComputePipeline(Device, WavefrontBinPipeline);
+    SDL_ReleaseGPUComputePipeline(Device, WavefrontScanPipeline);
+    SDL_ReleaseGPUComputePipeline(Device, WavefrontSortPipeline);
+    SDL_ReleaseGPUComputePipeline(Device, RestirInitialPipeline);
+    SDL_ReleaseGPUComputePipeline(Device, RestirSpatialPipeline);
+    SDL_ReleaseGPUComputePipeline(Device, RadianceTrainPipeline);
+    SDL_ReleaseGPUComputePipeline(Device, RadianceResolvePipeline);
+    SDL_ReleaseGPUComputePipeline(Device, SunInvalidatePipeline);
+    SDL_ReleaseGPUComputePipeline(Device, AllocatePipeline);
+    SDL_ReleaseGPUComputePipeline(Device, AllocatePreparePipeline);
+    SDL_ReleaseGPUComputePipeline(Device, UpscalePipeline);
+    SDL_ReleaseGPUComputePipeline(Device, TileDistancePipeline);
+    SDL_ReleaseGPUBuffer(Device, PathBuffers[0]);
+    SDL_ReleaseGPUBuffer(Device, PathBuffers[1]);
+    SDL_ReleaseGPUBuffer(Device, HitBuffer);
+    SDL_ReleaseGPUBuffer(Device, ShadowBuffer);
+    SDL_ReleaseGPUBuffer(Device, CounterBuffer);
+    SDL_ReleaseGPUBuffer(Device, ArgsBuffer);
+    SDL_ReleaseGPUBuffer(Device, CandidateBuffer);
+    SDL_ReleaseGPUBuffer(Device, RadianceCacheBuffer);
+    SDL_ReleaseGPUBuffer(Device, SunCacheBuffer);
+    SDL_ReleaseGPUBuffer(Device, PixelBuffer);
+    SDL_ReleaseGPUBuffer(Device, PixelArgsBuffer);
+    SDL_ReleaseGPUBuffer(Device, PrimaryBuffer);
+    SDL_ReleaseGPUBuffer(Device, SortBuffer);
+    SDL_ReleaseGPUBuffer(Device, OrderBuffer);
+    SDL_ReleaseGPUBuffer(Device, StatsBuffer);
+    for (int i = 0; i < kStatsLatency; i++)
+    {
+        SDL_ReleaseGPUTransferBuffer(Device, DownloadBuffers[i]);
+        SDL_ReleaseGPUTransferBuffer(Device, StatsDownloadBuffers[i]);
+    }
     SDL_ReleaseGPUTexture(Device, GroupTexture);
     SDL_ReleaseGPUTexture(Device, ChunkTexture);
     SDL_ReleaseGPUTexture(Device, BlockTexture);
-    SDL_ReleaseGPUTexture(Device, ColorTexture);
+    SDL_ReleaseGPUTexture(Device, BlueNoiseTexture);
+    SDL_ReleaseGPUTexture(Device, SampleTexture);
+    SDL_ReleaseGPUTexture(Device, FeatureTexture);
+    SDL_ReleaseGPUTexture(Device, TileTexture);
+    for (int i = 0; i < 2; i++)
+    {
+        SDL_ReleaseGPUTexture(Device, ColorTextures[i]);
+        SDL_ReleaseGPUTexture(Device, MomentTextures[i]);
+        SDL_ReleaseGPUTexture(Device, DenoiseTextures[i]);
+        SDL_ReleaseGPUTexture(Device, UpscaleTextures[i]);
+        SDL_ReleaseGPUBuffer(Device, ReservoirBuffers[i]);
+        SDL_ReleaseGPUBuffer(Device, SurfaceBuffers[i]);
+    }
 }
 
 void World::Update(Camera& camera)
 {
-    int cameraX = camera.GetPosition().x / Chunk::kWidth - kWidth / 2;
-    int cameraZ = camera.GetPosition().z / Chunk::kWidth - kWidth / 2;
+    if (StatsFrame >= kStatsLatency)
+    {
+        ReadStats();
+    }
+    if (DownloadFrames[StatsFrame % kStatsLatency] >= 0)
+    {
+        ReadBenchmark();
+    }
+    // Only recenter once the camera is Hysteresis blocks past the chunk boundary so that hovering
+    // around a boundary doesn't regenerate a full row of chunks every time it's crossed
+    float margin = Hysteresis / Chunk::kWidth;
+    float chunkX = camera.GetPosition().x / Chunk::kWidth - kWidth / 2;
+    float chunkZ = camera.GetPosition().z / Chunk::kWidth - kWidth / 2;
+    int cameraX = WorldStateBuffer->X;
+    int cameraZ = WorldStateBuffer->Z;
+    if (chunkX < cameraX - margin || chunkX >= cameraX + 1 + margin)
+    {
+        cameraX = std::floor(chunkX);
+    }
+    if (chunkZ < cameraZ - margin || chunkZ >= cameraZ + 1 + margin)
+    {
+        cameraZ = std::floor(chunkZ);
+    }
     int offsetX = cameraX - WorldStateBuffer->X;
     int offsetZ = cameraZ - WorldStateBuffer->Z;
     if (offsetX || offsetZ)
     {
-        WorldStateBuffer.Get().X = cameraX;
-        WorldStateBuffer.Get().Z = cameraZ;
         static constexpr int kNull = -1;
         glm::ivec2 chunkMap[kWidth][kWidth];
-        std::vector<glm::ivec2> outOfBoundsChunks;
-        outOfBoundsChunks.reserve(kWidth * kWidth);
         for (int x = 0; x < kWidth; x++)
         for (int z = 0; z < kWidth; z++)
         {
@@ -303,80 +837,239 @@ void World::Update(Camera& camera)
             int newZ = z - offsetZ;
             if (newX < 0 || newZ < 0 || newX >= kWidth || newZ >= kWidth)
             {
-                outOfBoundsChunks.push_back(ChunkMap[x][z]);
+                SaveChunk(x, z);
+                OutOfBoundsChunks.push_back(ChunkMap[x][z]);
             }
             else
             {
                 chunkMap[newX][newZ] = ChunkMap[x][z];
             }
         }
+        WorldStateBuffer.Get().X = cameraX;
+        WorldStateBuffer.Get().Z = cameraZ;
         std::memcpy(ChunkMap, chunkMap, sizeof(ChunkMap));
         for (int x = 0; x < kWidth; x++)
         for (int z = 0; z < kWidth; z++)
         {
             if (ChunkMap[x][z].x != kNull)
             {
-                SetChunksBuffer.Emplace(Device, x, z, ChunkMap[x][z].x, ChunkMap[x][z].y);
+                SetChunk(x, z);
                 continue;
             }
-            glm::ivec2 position = outOfBoundsChunks.back();
-            outOfBoundsChunks.pop_back();
+            glm::ivec2 position = OutOfBoundsChunks.back();
+            OutOfBoundsChunks.pop_back();
             ChunkMap[x][z] = position;
-            Chunk& chunk = Chunks[position.x][position.y];
-            chunk.AddFlags(ChunkFlagsGenerate);
-            SetChunksBuffer.Emplace(Device, x, z, position.x, position.y);
-            ClearChunks.emplace_back(position.x, position.y);
-            UpdateGroups.insert(position);
+            QueueChunk(position.x, position.y);
+            Chunks[position.x][position.y].RemoveFlags(ChunkFlagsPreview);
+            SetChunk(x, z);
+            ClearChunks.push_back(position);
+            UpdateGroups.set(position.x * kWidth + position.y);
+        }
+        SDL_assert(OutOfBoundsChunks.empty());
+        for (int x = 0; x < kWidth; x++)
+        for (int z = 0; z < kWidth; z++)
+        {
+            InverseChunkMap[ChunkMap[x][z].x][ChunkMap[x][z].y] = {x, z};
         }
-        SDL_assert(outOfBoundsChunks.empty());
     }
-    std::vector<glm::ivec2> jobs;
-    for (int inX = 0; inX < kWidth; inX++)
-    for (int inZ = 0; inZ < kWidth; inZ++)
+    Jobs.clear();
+    Chunk* previous = nullptr;
+    Chunk* chunk = PendingChunks;
+    while (chunk)
     {
-        int outX = ChunkMap[inX][inZ].x;
-        int outZ = ChunkMap[inX][inZ].y;
-        Chunk& chunk = Chunks[outX][outZ];
-        if (chunk.GetFlags() & ChunkFlagsGenerate)
+        Chunk* next = chunk->GetNext();
+        if (chunk->GetFlags() & ChunkFlagsGenerate)
         {
-            jobs.push_back({inX, inZ});
+            int index = chunk - &Chunks[0][0];
+            Jobs.push_back(InverseChunkMap[index / kWidth][index % kWidth]);
+            previous = chunk;
+        }
+        else
+        {
+            if (previous)
+            {
+                previous->SetNext(next);
+            }
+            else
+            {
+                PendingChunks = next;
+            }
+            chunk->SetNext(nullptr);
+            chunk->RemoveFlags(ChunkFlagsQueued);
         }
+        chunk = next;
     }
-    if (!jobs.empty())
+    if (!Jobs.empty())
     {
-        int maxJobs = std::min(jobs.size(), SetBlocksBuffers.size() - SetBlocksBufferCount);
-        std::vector<int> jobIndices(maxJobs);
-        std::iota(jobIndices.begin(), jobIndices.end(), 0);
-        // https://en.cppreference.com/cpp/17
-        // Somehow Apple Clang doesn't support execution policies yet (even with -fexperimental-library)
+        int numBuffers = SetBlocksBuffers.size() - SetBlocksBufferCount;
+        // While many chunks are pending, upload cheap previews first so that the terrain shape appears
+        // across the whole window within a few frames. The detailed chunks replace them afterwards
+        bool preview = false;
+        if (Jobs.size() > numBuffers)
+        {
+            auto it = std::remove_if(Jobs.begin(), Jobs.end(), [this](const glm::ivec2& job)
+            {
+                glm::ivec2 position = ChunkMap[job.x][job.y];
+                return Chunks[position.x][position.y].GetFlags() & ChunkFlagsPreview;
+            });
+            if (it != Jobs.begin())
+            {
+                Jobs.erase(it, Jobs.end());
+                preview = true;
+            }
+        }
+        int chunksPerJob = preview ? kPreviewsPerJob : 1;
+        int numChunks = std::min<int>(Jobs.size(), numBuffers * chunksPerJob);
+        int maxJobs = (numChunks + chunksPerJob - 1) / chunksPerJob;
+        // Generate the chunks closest to the camera first so that the spawn area is usable long
+        // before the rest of the world has finished generating
+        glm::vec2 center;
+        center.x = camera.GetPosition().x / Chunk::kWidth - WorldStateBuffer->X - 0.5f;
+        center.y = camera.GetPosition().z / Chunk::kWidth - WorldStateBuffer->Z - 0.5f;
+        std::partial_sort(Jobs.begin(), Jobs.begin() + numChunks, Jobs.end(), [&center](const glm::ivec2& a, const glm::ivec2& b)
+        {
+            glm::vec2 distanceA = glm::vec2(a) - center;
+            glm::vec2 distanceB = glm::vec2(b) - center;
+            return glm::dot(distanceA, distanceA) < glm::dot(distanceB, distanceB);
+        });
+        for (int i = 0; i < numChunks; i++)
+        {
+            glm::ivec2 position = ChunkMap[Jobs[i].x][Jobs[i].y];
+            if (Chunks[position.x][position.y].GetFlags() & ChunkFlagsPreview)
+            {
+                ClearChunks.push_back(position);
+            }
+        }
+        // With only a few chunks pending (e.g. after a teleport) the idle workers are spread across the
+        // tiles of each chunk instead so that the chunk under the camera isn't bound by a single core
+        int tilesPerChunk = preview ? 1 : std::min(numBuffers / std::max(numChunks, 1), Chunk::kTileCount);
+        // Looked up before the workers start since loading an entry invalidates it
+        for (int i = 0; i < numChunks; i++)
+        {
+            CacheIndices[i] = FindChunk(WorldStateBuffer->X + Jobs[i].x, WorldStateBuffer->Z + Jobs[i].y);
+            if (CacheIndices[i] != -1)
+            {
+                tilesPerChunk = 1;
+            }
+        }
+        if (tilesPerChunk > 1)
+        {
+            GenerateTiles(Jobs.data(), numChunks, tilesPerChunk);
+            maxJobs = numChunks * tilesPerChunk;
+        }
+        else
+        {
+            // https://en.cppreference.com/cpp/17
+            // Somehow Apple Clang doesn't support execution policies yet (even with -fexperimental-library)
 #if !SDL_PLATFORM_APPLE
-        std::for_each(std::execution::par, jobIndices.begin(), jobIndices.end(), [this, &jobs](int i)
+            std::for_each(std::execution::par, JobIndices.begin(), JobIndices.begin() + maxJobs, [&](int i)
 #else
-        for (int i : jobIndices)
+            for (int i = 0; i < maxJobs; i++)
+#endif
+            {
+                int bufferIndex = SetBlocksBufferCount + i;
+                for (int j = i * chunksPerJob; j < std::min((i + 1) * chunksPerJob, numChunks); j++)
+                {
+                    int inX = Jobs[j].x;
+                    int inZ = Jobs[j].y;
+                    int outX = ChunkMap[inX][inZ].x;
+                    int outZ = ChunkMap[inX][inZ].y;
+                    Chunk& chunk = Chunks[outX][outZ];
+                    WorldProxy proxy{*this, SetBlocksBuffers[bufferIndex], outX, outZ};
+                    proxy.Clear();
+                    if (CacheIndices[j] != -1)
+                    {
+                        LoadChunk(proxy, CacheIndices[j], outX, outZ);
+                        chunk.RemoveFlags(ChunkFlagsGenerate | ChunkFlagsPreview);
+                    }
+                    else if (preview)
+                    {
+                        chunk.GeneratePreview(proxy, WorldStateBuffer->X + inX, WorldStateBuffer->Z + inZ);
+                    }
+                    else
+                    {
+                        chunk.Generate(proxy, WorldStateBuffer->X + inX, WorldStateBuffer->Z + inZ);
+                    }
+                }
+            }
+#if !SDL_PLATFORM_APPLE
+            );
 #endif
+        }
+        for (int i = 0; i < numChunks; i++)
         {
-            int bufferIndex = SetBlocksBufferCount + i;
-            int inX = jobs[i].x;
-            int inZ = jobs[i].y;
+            int inX = Jobs[i].x;
+            int inZ = Jobs[i].y;
             int outX = ChunkMap[inX][inZ].x;
             int outZ = ChunkMap[inX][inZ].y;
-            Chunk& chunk = Chunks[outX][outZ];
-            WorldProxy proxy{*this, SetBlocksBuffers[bufferIndex], outX, outZ};
-            chunk.Generate(proxy, WorldStateBuffer->X + inX, WorldStateBuffer->Z + inZ);
+            UpdateGroups.set(outX * kWidth + outZ);
+            SetChunk(inX, inZ);
+            if (CacheIndices[i] != -1)
+            {
+                Cache[CacheIndices[i]].Valid = false;
+                // Chunks loaded from the cache may have brought lights back
+                if (!Lights[outX][outZ].empty())
+                {
+                    LightsDirty = true;
+                }
+            }
+        }
+        SetBlocksBufferCount += maxJobs;
+        if (numChunks > 0)
+        {
+            SunDirty = true;
+            RadianceDirty = true;
+            Dirty = true;
         }
+    }
+    // Growing any of the scratch vectors past what Init reserved would reallocate them
+    SDL_assert(Jobs.capacity() == JobsCapacity);
+    SDL_assert(OutOfBoundsChunks.capacity() == OutOfBoundsCapacity);
+    SDL_assert(ClearChunks.capacity() == ClearCapacity);
+}
+
+void World::GenerateTiles(const glm::ivec2* jobs, int numChunks, int tilesPerChunk)
+{
+    int maxJobs = numChunks * tilesPerChunk;
+    for (int i = 0; i < numChunks; i++)
+    {
+        int outX = ChunkMap[jobs[i].x][jobs[i].y].x;
+        int outZ = ChunkMap[jobs[i].x][jobs[i].y].y;
+        WorldProxy proxy{*this, SetBlocksBuffers[SetBlocksBufferCount + i * tilesPerChunk], outX, outZ};
+        proxy.Clear();
+    }
+    // https://en.cppreference.com/cpp/17
+    // Somehow Apple Clang doesn't support execution policies yet (even with -fexperimental-library)
 #if !SDL_PLATFORM_APPLE
-        );
+    std::for_each(std::execution::par, JobIndices.begin(), JobIndices.begin() + maxJobs, [&](int i)
+#else
+    for (int i = 0; i < maxJobs; i++)
 #endif
-        for (int i = 0; i < maxJobs; i++)
+    {
+        int bufferIndex = SetBlocksBufferCount + i;
+        int chunkIndex = i / tilesPerChunk;
+        int inX = jobs[chunkIndex].x;
+        int inZ = jobs[chunkIndex].y;
+        int outX = ChunkMap[inX][inZ].x;
+        int outZ = ChunkMap[inX][inZ].y;
+        const Chunk& chunk = Chunks[outX][outZ];
+        ChunkTree* trees = &Trees[chunkIndex * Chunk::kWidth * Chunk::kWidth];
+        WorldProxy proxy{*this, SetBlocksBuffers[bufferIndex], outX, outZ};
+        for (int tile = i % tilesPerChunk; tile < Chunk::kTileCount; tile += tilesPerChunk)
         {
-            int inX = jobs[i].x;
-            int inZ = jobs[i].y;
-            int outX = ChunkMap[inX][inZ].x;
-            int outZ = ChunkMap[inX][inZ].y;
-            UpdateGroups.insert({outX, outZ});
+            chunk.GenerateTile(proxy, WorldStateBuffer->X + inX, WorldStateBuffer->Z + inZ, tile, trees);
         }
-        SetBlocksBufferCount += maxJobs;
-        Dirty = true;
+    }
+#if !SDL_PLATFORM_APPLE
+    );
+#endif
+    for (int i = 0; i < numChunks; i++)
+    {
+        int outX = ChunkMap[jobs[i].x][jobs[i].y].x;
+        int outZ = ChunkMap[jobs[i].x][jobs[i].y].y;
+        ChunkTree* trees = &Trees[i * Chunk::kWidth * Chunk::kWidth];
+        WorldProxy proxy{*this, SetBlocksBuffers[SetBlocksBufferCount + i * tilesPerChunk], outX, outZ};
+        Chunks[outX][outZ].Decorate(proxy, trees);
     }
 }
 
@@ -390,6 +1083,23 @@ void World::Dispatch(SDL_GPUCommandBuffer* commandBuffer)
             SDL_Log("Failed to begin copy pass: %s", SDL_GetError());
             return;
         }
+        if (LightsDirty)
+        {
+            int lightCount = 0;
+            for (int x = 0; x < kWidth; x++)
+            for (int z = 0; z < kWidth; z++)
+            for (const glm::ivec3& light : Lights[x][z])
+            {
+                if (lightCount < kMaxLights)
+                {
+                    LightsBuffer.Emplace(Device, light, GetBlock(light));
+                    lightCount++;
+                }
+            }
+            LightsBuffer.Upload(Device, copyPass);
+            WorldStateBuffer.Get().LightCount = lightCount;
+            LightsDirty = false;
+        }
         WorldStateBuffer.Upload(Device, copyPass);
         BlockStateBuffer.Upload(Device, copyPass);
         for (int i = 0; i < SetBlocksBufferCount; i++)
@@ -470,29 +1180,7 @@ void World::Dispatch(SDL_GPUCommandBuffer* commandBuffer)
         SDL_EndGPUComputePass(computePass);
         SetBlocksBufferCount = 0;
     }
-    if (!UpdateGroups.empty())
-    {
-        DebugGroupBlock(commandBuffer, "World::Render::ClearGroups");
-        SDL_GPUStorageTextureReadWriteBinding writeTexture{};
-        writeTexture.texture = GroupTexture;
-        SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(commandBuffer, &writeTexture, 1, nullptr, 0);
-        if (!computePass)
-        {
-            SDL_Log("Failed to begin compute pass: %s", SDL_GetError());
-            return;
-        }
-        SDL_BindGPUComputePipeline(computePass, ClearGroupsPipeline);
-        for (const glm::ivec2& position : UpdateGroups)
-        {
-            int groupsX = (CHUNK_WIDTH / GROUP_SIZE + CLEAR_GROUPS_THREADS_X - 1) / CLEAR_GROUPS_THREADS_X;
-            int groupsY = (CHUNK_HEIGHT / GROUP_SIZE + CLEAR_GROUPS_THREADS_Y - 1) / CLEAR_GROUPS_THREADS_Y;
-            int groupsZ = (CHUNK_WIDTH / GROUP_SIZE + CLEAR_GROUPS_THREADS_Z - 1) / CLEAR_GROUPS_THREADS_Z;
-            SDL_PushGPUComputeUniformData(commandBuffer, 0, &position, sizeof(position));
-            SDL_DispatchGPUCompute(computePass, groupsX, groupsY, groupsZ);
-        }
-        SDL_EndGPUComputePass(computePass);
-    }
-    if (!UpdateGroups.empty())
+    if (UpdateGroups.any())
     {
         DebugGroupBlock(commandBuffer, "World::Render::UpdateGroups");
         SDL_GPUStorageTextureReadWriteBinding writeTexture{};
@@ -507,64 +1195,293 @@ void World::Dispatch(SDL_GPUCommandBuffer* commandBuffer)
         readTextures[0] = BlockTexture;
         SDL_BindGPUComputePipeline(computePass, SetGroupsPipeline);
         SDL_BindGPUComputeStorageTextures(computePass, 0, readTextures, 1);
-        for (const glm::ivec2& position : UpdateGroups)
+        for (int i = 0; i < kWidth * kWidth; i++)
         {
-            int groupsX = (CHUNK_WIDTH + UPDATE_GROUPS_THREADS_X - 1) / UPDATE_GROUPS_THREADS_X;
-            int groupsY = (CHUNK_HEIGHT + UPDATE_GROUPS_THREADS_Y - 1) / UPDATE_GROUPS_THREADS_Y;
-            int groupsZ = (CHUNK_WIDTH + UPDATE_GROUPS_THREADS_Z - 1) / UPDATE_GROUPS_THREADS_Z;
+            if (!UpdateGroups.test(i))
+            {
+                continue;
+            }
+            // One workgroup per group
+            glm::ivec2 position{i / kWidth, i % kWidth};
             SDL_PushGPUComputeUniformData(commandBuffer, 0, &position, sizeof(position));
-            SDL_DispatchGPUCompute(computePass, groupsX, groupsY, groupsZ);
+            SDL_DispatchGPUCompute(computePass, CHUNK_WIDTH / GROUP_SIZE, CHUNK_HEIGHT / GROUP_SIZE, CHUNK_WIDTH / GROUP_SIZE);
         }
         SDL_EndGPUComputePass(computePass);
     }
-    UpdateGroups.clear();
+    UpdateGroups.reset();
 }
 
 void World::Render(SDL_GPUCommandBuffer* commandBuffer, SDL_GPUTexture* colorTexture, Camera& camera)
 {
-    if (Width != camera.GetWidth() || Height != camera.GetHeight())
+    // Everything up to the upscale runs at a fraction of the output resolution
+    int factor = std::max(WorldStateBuffer->Options.UpscaleFactor, 1);
+    int width = (camera.GetWidth() + factor - 1) / factor;
+    int height = (camera.GetHeight() + factor - 1) / factor;
+    SDL_GPUTextureFormat colorFormat = SDL_GPU_TEXTUREFORMAT_R32G32B32A32_FLOAT;
+    if (WorldStateBuffer->Options.HalfAccumulation)
+    {
+        colorFormat = SDL_GPU_TEXTUREFORMAT_R16G16B16A16_FLOAT;
+    }
+    bool resized = false;
+    if (Width != width || Height != height || OutputWidth != camera.GetWidth() || OutputHeight != camera.GetHeight() ||
+        ColorFormat != colorFormat)
     {
         DebugGroupBlock(commandBuffer, "World::Render::Resize");
-        SDL_ReleaseGPUTexture(Device, ColorTexture);
+        // The current history is kept until it's resampled into the new textures
+        SDL_GPUTexture* colorHistory = ColorTextures[History];
+        SDL_GPUTexture* momentHistory = MomentTextures[History];
+        SDL_GPUTexture* upscaleHistory = UpscaleTextures[UpscaleHistory];
+        SDL_ReleaseGPUTexture(Device, SampleTexture);
+        SDL_ReleaseGPUTexture(Device, FeatureTexture);
+        SDL_ReleaseGPUTexture(Device, TileTexture);
+        SDL_ReleaseGPUTexture(Device, ColorTextures[1 - History]);
+        SDL_ReleaseGPUTexture(Device, MomentTextures[1 - History]);
+        SDL_ReleaseGPUTexture(Device, UpscaleTextures[1 - UpscaleHistory]);
+        for (int i = 0; i < 2; i++)
+        {
+            SDL_ReleaseGPUTexture(Device, DenoiseTextures[i]);
+            UpscaleTextures[i] = nullptr;
+            SDL_ReleaseGPUBuffer(Device, PathBuffers[i]);
+            SDL_ReleaseGPUBuffer(Device, ReservoirBuffers[i]);
+            SDL_ReleaseGPUBuffer(Device, SurfaceBuffers[i]);
+        }
+        SDL_ReleaseGPUBuffer(Device, CandidateBuffer);
+        SDL_ReleaseGPUBuffer(Device, PixelBuffer);
+        SDL_ReleaseGPUBuffer(Device, PixelArgsBuffer);
+        SDL_ReleaseGPUBuffer(Device, PrimaryBuffer);
+        SDL_ReleaseGPUBuffer(Device, OrderBuffer);
+        SDL_ReleaseGPUBuffer(Device, HitBuffer);
+        SDL_ReleaseGPUBuffer(Device, ShadowBuffer);
+        SDL_ReleaseGPUBuffer(Device, CounterBuffer);
+        SDL_ReleaseGPUBuffer(Device, ArgsBuffer);
         SDL_GPUTextureCreateInfo info{};
         info.format = SDL_GPU_TEXTUREFORMAT_R32G32B32A32_FLOAT;
         info.type = SDL_GPU_TEXTURETYPE_2D;
-        info.usage = SDL_GPU_TEXTUREUSAGE_COMPUTE_STORAGE_READ |
-            SDL_GPU_TEXTUREUSAGE_COMPUTE_STORAGE_SIMULTANEOUS_READ_WRITE;
-        info.width = camera.GetWidth();
-        info.height = camera.GetHeight();
+        info.usage = SDL_GPU_TEXTUREUSAGE_COMPUTE_STORAGE_READ | SDL_GPU_TEXTUREUSAGE_COMPUTE_STORAGE_WRITE;
+        info.width = width;
+        info.height = height;
         info.layer_count_or_depth = 1;
         info.num_levels = 1;
-        ColorTexture = SDL_CreateGPUTexture(Device, &info);
-        if (!ColorTexture)
+        // The wavefront kernels add to the sample texture in place
+        SDL_GPUTextureCreateInfo sampleInfo = info;
+        sampleInfo.usage = SDL_GPU_TEXTUREUSAGE_COMPUTE_STORAGE_READ | SDL_GPU_TEXTUREUSAGE_COMPUTE_STORAGE_SIMULTANEOUS_READ_WRITE;
+        SampleTexture = SDL_CreateGPUTexture(Device, &sampleInfo);
+        if (!SampleTexture)
         {
-            SDL_Log("Failed to create texture: %s", SDL_GetError());
+            SDL_Log("Failed to create sample texture: %s", SDL_GetError());
             return;
         }
-        Width = camera.GetWidth();
-        Height = camera.GetHeight();
-        Dirty = true;
-    }
-    if (Dirty || camera.GetDirty())
-    {
-        Sample = 0;
-        DebugGroupBlock(commandBuffer, "World::Render::ClearTexture");
-        SDL_GPUStorageTextureReadWriteBinding writeTexture{};
-        writeTexture.texture = ColorTexture;
-        SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(commandBuffer, &writeTexture, 1, nullptr, 0);
-        if (!computePass)
+        // The history is blitted from the old textures
+        SDL_GPUTextureCreateInfo historyInfo = info;
+        historyInfo.usage |= SDL_GPU_TEXTUREUSAGE_SAMPLER | SDL_GPU_TEXTUREUSAGE_COLOR_TARGET;
+        for (int i = 0; i < 2; i++)
         {
-            SDL_Log("Failed to begin compute pass: %s", SDL_GetError());
+            historyInfo.format = colorFormat;
+            ColorTextures[i] = SDL_CreateGPUTexture(Device, &historyInfo);
+            if (!ColorTextures[i])
+            {
+                SDL_Log("Failed to create color texture: %s", SDL_GetError());
+                return;
+            }
+            historyInfo.format = SDL_GPU_TEXTUREFORMAT_R32G32B32A32_FLOAT;
+            MomentTextures[i] = SDL_CreateGPUTexture(Device, &historyInfo);
+            if (!MomentTextures[i])
+            {
+                SDL_Log("Failed to create moment texture: %s", SDL_GetError());
+                return;
+            }
+            DenoiseTextures[i] = SDL_CreateGPUTexture(Device, &info);
+            if (!DenoiseTextures[i])
+            {
+                SDL_Log("Failed to create denoise texture: %s", SDL_GetError());
+                return;
+            }
+        }
+        info.format = SDL_GPU_TEXTUREFORMAT_R32_UINT;
+        FeatureTexture = SDL_CreateGPUTexture(Device, &info);
+        if (!FeatureTexture)
+        {
+            SDL_Log("Failed to create feature texture: %s", SDL_GetError());
             return;
         }
-        int groupsX = (Width + CLEAR_TEXTURE_THREADS_X - 1) / CLEAR_TEXTURE_THREADS_X;
-        int groupsY = (Height + CLEAR_TEXTURE_THREADS_Y - 1) / CLEAR_TEXTURE_THREADS_Y;
-        SDL_BindGPUComputePipeline(computePass, ClearTexturePipeline);
-        SDL_DispatchGPUCompute(computePass, groupsX, groupsY, 1);
-        SDL_EndGPUComputePass(computePass);
-        Dirty = false;
+        info.format = SDL_GPU_TEXTUREFORMAT_R32_FLOAT;
+        info.width = (width + TILE_SIZE - 1) / TILE_SIZE;
+        info.height = (height + TILE_SIZE - 1) / TILE_SIZE;
+        TileTexture = SDL_CreateGPUTexture(Device, &info);
+        if (!TileTexture)
+        {
+            SDL_Log("Failed to create tile texture: %s", SDL_GetError());
+            return;
+        }
+        if (factor > 1)
+        {
+            historyInfo.width = camera.GetWidth();
+            historyInfo.height = camera.GetHeight();
+            for (int i = 0; i < 2; i++)
+            {
+                UpscaleTextures[i] = SDL_CreateGPUTexture(Device, &historyInfo);
+                if (!UpscaleTextures[i])
+                {
+                    SDL_Log("Failed to create upscale texture: %s", SDL_GetError());
+                    return;
+                }
+            }
+        }
+        // Queues are sized for one path per pixel
+        int numPixels = width * height;
+        SDL_GPUBufferCreateInfo bufferInfo{};
+        bufferInfo.usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE;
+        bufferInfo.size = numPixels * sizeof(PathState);
+        for (int i = 0; i < 2; i++)
+        {
+            PathBuffers[i] = SDL_CreateGPUBuffer(Device, &bufferInfo);
+            if (!PathBuffers[i])
+            {
+                SDL_Log("Failed to create path buffer: %s", SDL_GetError());
+                return;
+            }
+        }
+        bufferInfo.size = numPixels * sizeof(PathHit);
+        HitBuffer = SDL_CreateGPUBuffer(Device, &bufferInfo);
+        if (!HitBuffer)
+        {
+            SDL_Log("Failed to create hit buffer: %s", SDL_GetError());
+            return;
+        }
+        bufferInfo.size = numPixels * sizeof(ShadowRay);
+        ShadowBuffer = SDL_CreateGPUBuffer(Device, &bufferInfo);
+        if (!ShadowBuffer)
+        {
+            SDL_Log("Failed to create shadow buffer: %s", SDL_GetError());
+            return;
+        }
+        bufferInfo.size = 4 * sizeof(uint32_t);
+        CounterBuffer = SDL_CreateGPUBuffer(Device, &bufferInfo);
+        if (!CounterBuffer)
+        {
+            SDL_Log("Failed to create counter buffer: %s", SDL_GetError());
+            return;
+        }
+        // Reservoirs and their surfaces are kept for the next frame's temporal reuse
+        for (int i = 0; i < 2; i++)
+        {
+            bufferInfo.size = numPixels * sizeof(Reservoir);
+            ReservoirBuffers[i] = SDL_CreateGPUBuffer(Device, &bufferInfo);
+            if (!ReservoirBuffers[i])
+            {
+                SDL_Log("Failed to create reservoir buffer: %s", SDL_GetError());
+                return;
+            }
+            bufferInfo.size = numPixels * sizeof(ReservoirSurface);
+            SurfaceBuffers[i] = SDL_CreateGPUBuffer(Device, &bufferInfo);
+            if (!SurfaceBuffers[i])
+            {
+                SDL_Log("Failed to create surface buffer: %s", SDL_GetError());
+                return;
+            }
+        }
+        bufferInfo.size = numPixels * sizeof(Reservoir);
+        CandidateBuffer = SDL_CreateGPUBuffer(Device, &bufferInfo);
+        if (!CandidateBuffer)
+        {
+            SDL_Log("Failed to create candidate buffer: %s", SDL_GetError());
+            return;
+        }
+        bufferInfo.size = numPixels * sizeof(uint32_t);
+        PixelBuffer = SDL_CreateGPUBuffer(Device, &bufferInfo);
+        if (!PixelBuffer)
+        {
+            SDL_Log("Failed to create pixel buffer: %s", SDL_GetError());
+            return;
+        }
+        bufferInfo.size = numPixels * sizeof(PrimaryHit);
+        PrimaryBuffer = SDL_CreateGPUBuffer(Device, &bufferInfo);
+        if (!PrimaryBuffer)
+        {
+            SDL_Log("Failed to create primary buffer: %s", SDL_GetError());
+            return;
+        }
+        bufferInfo.size = numPixels * sizeof(uint32_t);
+        OrderBuffer = SDL_CreateGPUBuffer(Device, &bufferInfo);
+        if (!OrderBuffer)
+        {
+            SDL_Log("Failed to create order buffer: %s", SDL_GetError());
+            return;
+        }
+        bufferInfo.usage = SDL_GPU_BUFFERUSAGE_INDIRECT | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE;
+        bufferInfo.size = 2 * sizeof(SDL_GPUIndirectDispatchCommand);
+        ArgsBuffer = SDL_CreateGPUBuffer(Device, &bufferInfo);
+        if (!ArgsBuffer)
+        {
+            SDL_Log("Failed to create args buffer: %s", SDL_GetError());
+            return;
+        }
+        // The dispatch followed by the number of pixels it covers
+        bufferInfo.usage |= SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ;
+        bufferInfo.size = sizeof(SDL_GPUIndirectDispatchCommand) + sizeof(uint32_t);
+        PixelArgsBuffer = SDL_CreateGPUBuffer(Device, &bufferInfo);
+        if (!PixelArgsBuffer)
+        {
+            SDL_Log("Failed to create pixel args buffer: %s", SDL_GetError());
+            return;
+        }
+        auto blit = [&](SDL_GPUTexture* source, SDL_GPUTexture* destination, int sourceWidth, int sourceHeight,
+            int destinationWidth, int destinationHeight)
+        {
+            SDL_GPUBlitInfo blitInfo{};
+            blitInfo.source.texture = source;
+            blitInfo.source.w = sourceWidth;
+            blitInfo.source.h = sourceHeight;
+            blitInfo.destination.texture = destination;
+            blitInfo.destination.w = destinationWidth;
+            blitInfo.destination.h = destinationHeight;
+            blitInfo.filter = SDL_GPU_FILTER_NEAREST;
+            SDL_BlitGPUTexture(commandBuffer, &blitInfo);
+            SDL_ReleaseGPUTexture(Device, source);
+        };
+        // Nothing to resample on the first frame or when the upscale was just enabled
+        if (!colorHistory || (factor > 1 && !upscaleHistory))
+        {
+            Dirty = true;
+        }
+        if (colorHistory)
+        {
+            blit(colorHistory, ColorTextures[History], Width, Height, width, height);
+            blit(momentHistory, MomentTextures[History], Width, Height, width, height);
+        }
+        if (upscaleHistory && factor > 1)
+        {
+            blit(upscaleHistory, UpscaleTextures[UpscaleHistory], OutputWidth, OutputHeight, camera.GetWidth(), camera.GetHeight());
+        }
+        else
+        {
+            SDL_ReleaseGPUTexture(Device, upscaleHistory);
+        }
+        Width = width;
+        Height = height;
+        OutputWidth = camera.GetWidth();
+        OutputHeight = camera.GetHeight();
+        ColorFormat = colorFormat;
+        resized = true;
     }
+    // Camera movement only drops the history when temporal reprojection is disabled
+    // A resize reprojects the resampled history like a camera movement
+    bool moved = camera.GetDirty() || resized;
+    bool reset = Dirty || (moved && !WorldStateBuffer->Options.Temporal);
+    bool dirty = Dirty;
+    int edits = EditCount;
     Sample++;
+    int32_t flags[4]{reset, moved, reset ? 0 : edits, Sample};
+    // Primary hits are only reused while nothing they depend on changed (and the upscale needs every jitter)
+    int32_t retrace = reset || moved || edits > 0 || factor > 1;
+    Dirty = false;
+    EditCount = 0;
+    // Once the stats show nothing was allocated since the last change, the image is final and nothing
+    // needs tracing or filtering until something changes (the upscale adds every frame's jitter so it's excluded)
+    StillFrames = reset || moved || edits > 0 ? 0 : StillFrames + 1;
+    // A benchmark keeps sampling every frame so its error follows the sample count
+    bool benchmarking = BenchmarkSample >= 0;
+    bool idle = !benchmarking && StillFrames > kStatsLatency && Stats.Paths == 0 && factor == 1;
     {
         SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(commandBuffer);
         if (!copyPass)
@@ -573,20 +1490,64 @@ void World::Render(SDL_GPUCommandBuffer* commandBuffer, SDL_GPUTexture* colorTex
             return;
         }
         camera.Upload(Device, copyPass);
+        PreviousCameraBuffer.Upload(Device, copyPass);
+        EditsBuffer.Upload(Device, copyPass);
         SDL_EndGPUCopyPass(copyPass);
     }
+    if (!WorldStateBuffer->Options.RadianceCache)
     {
-        DebugGroupBlock(commandBuffer, "World::Render::Raytrace");
+        // Nothing tracks edits while it's disabled
+        RadianceDirty = true;
+    }
+    else if (!idle)
+    {
+        RenderRadianceCache(commandBuffer, camera, RadianceDirty, RadianceDirty ? 0 : edits);
+        RadianceDirty = false;
+    }
+    if (!WorldStateBuffer->Options.SunCache)
+    {
+        // Nothing tracks edits while it's disabled
+        SunDirty = true;
+    }
+    else if (SunDirty || edits > 0)
+    {
+        DebugGroupBlock(commandBuffer, "World::Render::SunInvalidate");
+        SDL_GPUStorageBufferReadWriteBinding writeBuffer{};
+        writeBuffer.buffer = SunCacheBuffer;
+        SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(commandBuffer, nullptr, 0, &writeBuffer, 1);
+        if (!computePass)
+        {
+            SDL_Log("Failed to begin compute pass: %s", SDL_GetError());
+            return;
+        }
+        int32_t sunFlags[2]{SunDirty, SunDirty ? 0 : edits};
+        SDL_GPUBuffer* readBuffers[2]{};
+        readBuffers[0] = WorldStateBuffer.GetBuffer();
+        readBuffers[1] = EditsBuffer.GetBuffer();
+        SDL_BindGPUComputePipeline(computePass, SunInvalidatePipeline);
+        SDL_PushGPUComputeUniformData(commandBuffer, 0, sunFlags, sizeof(sunFlags));
+        SDL_BindGPUComputeStorageBuffers(computePass, 0, readBuffers, 2);
+        SDL_DispatchGPUCompute(computePass, SUN_CACHE_SIZE / SUN_INVALIDATE_THREADS_X, 1, 1);
+        SDL_EndGPUComputePass(computePass);
+        SunDirty = false;
+    }
+    if (!idle)
+    {
+        // Conservative distance each tile's primary rays can skip through empty groups
+        DebugGroupBlock(commandBuffer, "World::Render::TileDistance");
         SDL_GPUStorageTextureReadWriteBinding writeTexture{};
-        writeTexture.texture = ColorTexture;
+        writeTexture.texture = TileTexture;
         SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(commandBuffer, &writeTexture, 1, nullptr, 0);
         if (!computePass)
         {
             SDL_Log("Failed to begin compute pass: %s", SDL_GetError());
             return;
         }
-        int groupsX = (Width + RAYTRACE_THREADS_X - 1) / RAYTRACE_THREADS_X;
-        int groupsY = (Height + RAYTRACE_THREADS_Y - 1) / RAYTRACE_THREADS_Y;
+        int tilesX = (Width + TILE_SIZE - 1) / TILE_SIZE;
+        int tilesY = (Height + TILE_SIZE - 1) / TILE_SIZE;
+        int groupsX = (tilesX + TILE_DISTANCE_THREADS_X - 1) / TILE_DISTANCE_THREADS_X;
+        int groupsY = (tilesY + TILE_DISTANCE_THREADS_Y - 1) / TILE_DISTANCE_THREADS_Y;
+        int32_t size[2]{Width, Height};
         SDL_GPUTexture* readTextures[3]{};
         SDL_GPUBuffer* readBuffers[3]{};
         readTextures[0] = BlockTexture;
@@ -595,13 +1556,239 @@ void World::Render(SDL_GPUCommandBuffer* commandBuffer, SDL_GPUTexture* colorTex
         readBuffers[0] = camera.GetBuffer();
         readBuffers[1] = WorldStateBuffer.GetBuffer();
         readBuffers[2] = BlockStateBuffer.GetBuffer();
+        SDL_BindGPUComputePipeline(computePass, TileDistancePipeline);
+        SDL_PushGPUComputeUniformData(commandBuffer, 0, size, sizeof(size));
+        SDL_BindGPUComputeStorageTextures(computePass, 0, readTextures, 3);
+        SDL_BindGPUComputeStorageBuffers(computePass, 0, readBuffers, 3);
+        SDL_DispatchGPUCompute(computePass, groupsX, groupsY, 1);
+        SDL_EndGPUComputePass(computePass);
+    }
+    if (!idle && WorldStateBuffer->Options.Restir && WorldStateBuffer->LightCount > 0)
+    {
+        RenderRestir(commandBuffer, camera, reset || resized, retrace);
+    }
+    if (!idle)
+    {
+        DebugGroupBlock(commandBuffer, "World::Render::Allocate");
+        auto prepare = [&](int stage)
+        {
+            SDL_GPUStorageBufferReadWriteBinding writeBuffers[2]{};
+            writeBuffers[0].buffer = PixelArgsBuffer;
+            writeBuffers[1].buffer = StatsBuffer;
+            SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(commandBuffer, nullptr, 0, writeBuffers, 2);
+            if (!computePass)
+            {
+                SDL_Log("Failed to begin compute pass: %s", SDL_GetError());
+                return false;
+            }
+            SDL_BindGPUComputePipeline(computePass, AllocatePreparePipeline);
+            SDL_PushGPUComputeUniformData(commandBuffer, 0, &stage, sizeof(stage));
+            SDL_DispatchGPUCompute(computePass, 1, 1, 1);
+            SDL_EndGPUComputePass(computePass);
+            return true;
+        };
+        if (!prepare(0))
+        {
+            return;
+        }
+        SDL_GPUStorageBufferReadWriteBinding writeBuffers[2]{};
+        writeBuffers[0].buffer = PixelBuffer;
+        writeBuffers[1].buffer = PixelArgsBuffer;
+        SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(commandBuffer, nullptr, 0, writeBuffers, 2);
+        if (!computePass)
+        {
+            SDL_Log("Failed to begin compute pass: %s", SDL_GetError());
+            return;
+        }
+        int groupsX = (Width + ALLOCATE_THREADS_X - 1) / ALLOCATE_THREADS_X;
+        int groupsY = (Height + ALLOCATE_THREADS_Y - 1) / ALLOCATE_THREADS_Y;
+        SDL_GPUTexture* readTextures[2]{};
+        SDL_GPUBuffer* readBuffers[1]{};
+        readTextures[0] = ColorTextures[History];
+        readTextures[1] = MomentTextures[History];
+        readBuffers[0] = WorldStateBuffer.GetBuffer();
+        SDL_BindGPUComputePipeline(computePass, AllocatePipeline);
+        SDL_PushGPUComputeUniformData(commandBuffer, 0, flags, sizeof(flags));
+        SDL_BindGPUComputeStorageTextures(computePass, 0, readTextures, 2);
+        SDL_BindGPUComputeStorageBuffers(computePass, 0, readBuffers, 1);
+        SDL_DispatchGPUCompute(computePass, groupsX, groupsY, 1);
+        SDL_EndGPUComputePass(computePass);
+        if (!prepare(1))
+        {
+            return;
+        }
+    }
+    if (!idle && WorldStateBuffer->Options.Wavefront)
+    {
+        RenderWavefront(commandBuffer, camera, retrace);
+    }
+    else if (!idle)
+    {
+        DebugGroupBlock(commandBuffer, "World::Render::Raytrace");
+        SDL_GPUStorageTextureReadWriteBinding writeTextures[2]{};
+        SDL_GPUStorageBufferReadWriteBinding writeBuffers[3]{};
+        writeTextures[0].texture = SampleTexture;
+        writeTextures[1].texture = FeatureTexture;
+        writeBuffers[0].buffer = SunCacheBuffer;
+        writeBuffers[1].buffer = PrimaryBuffer;
+        writeBuffers[2].buffer = StatsBuffer;
+        SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(commandBuffer, writeTextures, 2, writeBuffers, 3);
+        if (!computePass)
+        {
+            SDL_Log("Failed to begin compute pass: %s", SDL_GetError());
+            return;
+        }
+        SDL_GPUTexture* readTextures[5]{};
+        SDL_GPUBuffer* readBuffers[8]{};
+        readTextures[0] = BlockTexture;
+        readTextures[1] = GroupTexture;
+        readTextures[2] = ChunkTexture;
+        readTextures[3] = BlueNoiseTexture;
+        readTextures[4] = TileTexture;
+        readBuffers[0] = camera.GetBuffer();
+        readBuffers[1] = WorldStateBuffer.GetBuffer();
+        readBuffers[2] = BlockStateBuffer.GetBuffer();
+        readBuffers[3] = LightsBuffer.GetBuffer();
+        readBuffers[4] = ReservoirBuffers[ReservoirHistory];
+        readBuffers[5] = RadianceCacheBuffer;
+        readBuffers[6] = PixelBuffer;
+        readBuffers[7] = PixelArgsBuffer;
+        int32_t uniforms[2]{Sample, retrace};
         SDL_BindGPUComputePipeline(computePass, RaytracePipeline);
-        SDL_PushGPUComputeUniformData(commandBuffer, 0, &Sample, sizeof(Sample));
+        SDL_PushGPUComputeUniformData(commandBuffer, 0, uniforms, sizeof(uniforms));
+        SDL_BindGPUComputeStorageTextures(computePass, 0, readTextures, 5);
+        SDL_BindGPUComputeStorageBuffers(computePass, 0, readBuffers, 8);
+        SDL_DispatchGPUComputeIndirect(computePass, PixelArgsBuffer, 0);
+        SDL_EndGPUComputePass(computePass);
+    }
+    if (!idle)
+    {
+        DebugGroupBlock(commandBuffer, "World::Render::Accumulate");
+        SDL_GPUStorageTextureReadWriteBinding writeTextures[3]{};
+        writeTextures[0].texture = ColorTextures[1 - History];
+        writeTextures[1].texture = MomentTextures[1 - History];
+        writeTextures[2].texture = DenoiseTextures[0];
+        SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(commandBuffer, writeTextures, 3, nullptr, 0);
+        if (!computePass)
+        {
+            SDL_Log("Failed to begin compute pass: %s", SDL_GetError());
+            return;
+        }
+        int groupsX = (Width + ACCUMULATE_THREADS_X - 1) / ACCUMULATE_THREADS_X;
+        int groupsY = (Height + ACCUMULATE_THREADS_Y - 1) / ACCUMULATE_THREADS_Y;
+        SDL_GPUTexture* readTextures[3]{};
+        SDL_GPUBuffer* readBuffers[4]{};
+        readTextures[0] = SampleTexture;
+        readTextures[1] = ColorTextures[History];
+        readTextures[2] = MomentTextures[History];
+        readBuffers[0] = camera.GetBuffer();
+        readBuffers[1] = PreviousCameraBuffer.GetBuffer();
+        readBuffers[2] = WorldStateBuffer.GetBuffer();
+        readBuffers[3] = EditsBuffer.GetBuffer();
+        if (ColorFormat == SDL_GPU_TEXTUREFORMAT_R16G16B16A16_FLOAT)
+        {
+            SDL_BindGPUComputePipeline(computePass, AccumulateHalfPipeline);
+        }
+        else
+        {
+            SDL_BindGPUComputePipeline(computePass, AccumulatePipeline);
+        }
+        SDL_PushGPUComputeUniformData(commandBuffer, 0, flags, sizeof(flags));
         SDL_BindGPUComputeStorageTextures(computePass, 0, readTextures, 3);
+        SDL_BindGPUComputeStorageBuffers(computePass, 0, readBuffers, 4);
+        SDL_DispatchGPUCompute(computePass, groupsX, groupsY, 1);
+        SDL_EndGPUComputePass(computePass);
+        History = 1 - History;
+    }
+    {
+        DebugGroupBlock(commandBuffer, "World::Render::Stats");
+        SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(commandBuffer);
+        if (!copyPass)
+        {
+            SDL_Log("Failed to begin copy pass: %s", SDL_GetError());
+            return;
+        }
+        SDL_GPUBufferRegion source{};
+        source.buffer = StatsBuffer;
+        source.size = sizeof(WorldStats);
+        SDL_GPUTransferBufferLocation destination{};
+        destination.transfer_buffer = StatsDownloadBuffers[StatsFrame % kStatsLatency];
+        SDL_DownloadFromGPUBuffer(copyPass, &source, &destination);
+        SDL_EndGPUCopyPass(copyPass);
+        StatsFrame++;
+    }
+    RenderBenchmark(commandBuffer, moved || dirty);
+    SDL_GPUTexture* outputTexture = ColorTextures[History];
+    int denoiseIterations = benchmarking ? 0 : WorldStateBuffer->Options.DenoiseIterations;
+    if (!idle && denoiseIterations > 0)
+    {
+        // A-trous wavelet filter where each iteration doubles the step between taps
+        DebugGroupBlock(commandBuffer, "World::Render::Denoise");
+        int groupsX = (Width + DENOISE_THREADS_X - 1) / DENOISE_THREADS_X;
+        int groupsY = (Height + DENOISE_THREADS_Y - 1) / DENOISE_THREADS_Y;
+        for (int i = 0; i < denoiseIterations; i++)
+        {
+            SDL_GPUStorageTextureReadWriteBinding writeTexture{};
+            writeTexture.texture = DenoiseTextures[(i + 1) % 2];
+            SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(commandBuffer, &writeTexture, 1, nullptr, 0);
+            if (!computePass)
+            {
+                SDL_Log("Failed to begin compute pass: %s", SDL_GetError());
+                return;
+            }
+            SDL_GPUTexture* readTextures[3]{};
+            SDL_GPUBuffer* readBuffers[1]{};
+            readTextures[0] = DenoiseTextures[i % 2];
+            readTextures[1] = SampleTexture;
+            readTextures[2] = FeatureTexture;
+            readBuffers[0] = camera.GetBuffer();
+            int step = 1 << i;
+            SDL_BindGPUComputePipeline(computePass, DenoisePipeline);
+            SDL_PushGPUComputeUniformData(commandBuffer, 0, &step, sizeof(step));
+            SDL_BindGPUComputeStorageTextures(computePass, 0, readTextures, 3);
+            SDL_BindGPUComputeStorageBuffers(computePass, 0, readBuffers, 1);
+            SDL_DispatchGPUCompute(computePass, groupsX, groupsY, 1);
+            SDL_EndGPUComputePass(computePass);
+        }
+    }
+    // Left untouched from the last traced frame while idle
+    if (denoiseIterations > 0)
+    {
+        outputTexture = DenoiseTextures[denoiseIterations % 2];
+    }
+    if (factor > 1)
+    {
+        // Accumulates the jittered samples at the output resolution
+        DebugGroupBlock(commandBuffer, "World::Render::Upscale");
+        SDL_GPUStorageTextureReadWriteBinding writeTextures[2]{};
+        writeTextures[0].texture = UpscaleTextures[1 - UpscaleHistory];
+        writeTextures[1].texture = colorTexture;
+        SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(commandBuffer, writeTextures, 2, nullptr, 0);
+        if (!computePass)
+        {
+            SDL_Log("Failed to begin compute pass: %s", SDL_GetError());
+            return;
+        }
+        int groupsX = (OutputWidth + UPSCALE_THREADS_X - 1) / UPSCALE_THREADS_X;
+        int groupsY = (OutputHeight + UPSCALE_THREADS_Y - 1) / UPSCALE_THREADS_Y;
+        SDL_GPUTexture* readTextures[4]{};
+        SDL_GPUBuffer* readBuffers[3]{};
+        readTextures[0] = outputTexture;
+        readTextures[1] = SampleTexture;
+        readTextures[2] = MomentTextures[History];
+        readTextures[3] = UpscaleTextures[UpscaleHistory];
+        readBuffers[0] = camera.GetBuffer();
+        readBuffers[1] = PreviousCameraBuffer.GetBuffer();
+        readBuffers[2] = WorldStateBuffer.GetBuffer();
+        SDL_BindGPUComputePipeline(computePass, UpscalePipeline);
+        SDL_PushGPUComputeUniformData(commandBuffer, 0, flags, sizeof(flags));
+        SDL_BindGPUComputeStorageTextures(computePass, 0, readTextures, 4);
         SDL_BindGPUComputeStorageBuffers(computePass, 0, readBuffers, 3);
         SDL_DispatchGPUCompute(computePass, groupsX, groupsY, 1);
         SDL_EndGPUComputePass(computePass);
+        UpscaleHistory = 1 - UpscaleHistory;
     }
+    else
     {
         DebugGroupBlock(commandBuffer, "World::Render::SampleTexture");
         SDL_GPUStorageTextureReadWriteBinding writeTexture{};
@@ -615,10 +1802,362 @@ void World::Render(SDL_GPUCommandBuffer* commandBuffer, SDL_GPUTexture* colorTex
         int groupsX = (Width + SAMPLE_TEXTURE_THREADS_X - 1) / SAMPLE_TEXTURE_THREADS_X;
         int groupsY = (Height + SAMPLE_TEXTURE_THREADS_Y - 1) / SAMPLE_TEXTURE_THREADS_Y;
         SDL_GPUTexture* readTextures[1]{};
-        readTextures[0] = ColorTexture;
+        SDL_GPUBuffer* readBuffers[1]{};
+        readTextures[0] = outputTexture;
+        readBuffers[0] = WorldStateBuffer.GetBuffer();
         SDL_BindGPUComputePipeline(computePass, SampleTexturePipeline);
-        SDL_PushGPUComputeUniformData(commandBuffer, 0, &Sample, sizeof(Sample));
         SDL_BindGPUComputeStorageTextures(computePass, 0, readTextures, 1);
+        SDL_BindGPUComputeStorageBuffers(computePass, 0, readBuffers, 1);
+        SDL_DispatchGPUCompute(computePass, groupsX, groupsY, 1);
+        SDL_EndGPUComputePass(computePass);
+    }
+    // Reprojection only needs the camera of the last frame that moved since it's unchanged otherwise
+    if (moved)
+    {
+        PreviousCameraBuffer.Get() = camera.GetState();
+    }
+}
+
+void World::RenderWavefront(SDL_GPUCommandBuffer* commandBuffer, Camera& camera, bool retrace)
+{
+    DebugGroupBlock(commandBuffer, "World::Render::Wavefront");
+    {
+        SDL_GPUStorageTextureReadWriteBinding writeTextures[2]{};
+        SDL_GPUStorageBufferReadWriteBinding writeBuffers[2]{};
+        writeTextures[0].texture = SampleTexture;
+        writeTextures[1].texture = FeatureTexture;
+        writeBuffers[0].buffer = PathBuffers[0];
+        writeBuffers[1].buffer = CounterBuffer;
+        SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(commandBuffer, writeTextures, 2, writeBuffers, 2);
+        if (!computePass)
+        {
+            SDL_Log("Failed to begin compute pass: %s", SDL_GetError());
+            return;
+        }
+        SDL_GPUTexture* readTextures[2]{};
+        SDL_GPUBuffer* readBuffers[5]{};
+        readTextures[0] = BlueNoiseTexture;
+        readTextures[1] = TileTexture;
+        readBuffers[0] = camera.GetBuffer();
+        readBuffers[1] = PixelBuffer;
+        readBuffers[2] = PixelArgsBuffer;
+        readBuffers[3] = WorldStateBuffer.GetBuffer();
+        readBuffers[4] = PrimaryBuffer;
+        int32_t uniforms[2]{Sample, retrace};
+        SDL_BindGPUComputePipeline(computePass, WavefrontGeneratePipeline);
+        SDL_PushGPUComputeUniformData(commandBuffer, 0, uniforms, sizeof(uniforms));
+        SDL_BindGPUComputeStorageTextures(computePass, 0, readTextures, 2);
+        SDL_BindGPUComputeStorageBuffers(computePass, 0, readBuffers, 5);
+        SDL_DispatchGPUComputeIndirect(computePass, PixelArgsBuffer, 0);
+        SDL_EndGPUComputePass(computePass);
+    }
+    // Every stage is its own compute pass so that the queues written by one are visible to the next
+    auto prepare = [&](int queue)
+    {
+        SDL_GPUStorageBufferReadWriteBinding writeBuffers[2]{};
+        writeBuffers[0].buffer = CounterBuffer;
+        writeBuffers[1].buffer = ArgsBuffer;
+        SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(commandBuffer, nullptr, 0, writeBuffers, 2);
+        if (!computePass)
+        {
+            SDL_Log("Failed to begin compute pass: %s", SDL_GetError());
+            return false;
+        }
+        SDL_BindGPUComputePipeline(computePass, WavefrontPreparePipeline);
+        SDL_PushGPUComputeUniformData(commandBuffer, 0, &queue, sizeof(queue));
+        SDL_DispatchGPUCompute(computePass, 1, 1, 1);
+        SDL_EndGPUComputePass(computePass);
+        return true;
+    };
+    // Primary rays already leave in pixel order so only the later bounces are sorted
+    auto sort = [&](int queue)
+    {
+        {
+            SDL_GPUStorageBufferReadWriteBinding writeBuffer{};
+            writeBuffer.buffer = SortBuffer;
+            SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(commandBuffer, nullptr, 0, &writeBuffer, 1);
+            if (!computePass)
+            {
+                SDL_Log("Failed to begin compute pass: %s", SDL_GetError());
+                return false;
+            }
+            SDL_GPUBuffer* readBuffers[3]{};
+            readBuffers[0] = WorldStateBuffer.GetBuffer();
+            readBuffers[1] = PathBuffers[queue];
+            readBuffers[2] = CounterBuffer;
+            SDL_BindGPUComputePipeline(computePass, WavefrontBinPipeline);
+            SDL_PushGPUComputeUniformData(commandBuffer, 0, &queue, sizeof(queue));
+            SDL_BindGPUComputeStorageBuffers(computePass, 0, readBuffers, 3);
+            SDL_DispatchGPUComputeIndirect(computePass, ArgsBuffer, 0);
+            SDL_EndGPUComputePass(computePass);
+        }
+        {
+            SDL_GPUStorageBufferReadWriteBinding writeBuffer{};
+            writeBuffer.buffer = SortBuffer;
+            SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(commandBuffer, nullptr, 0, &writeBuffer, 1);
+            if (!computePass)
+            {
+                SDL_Log("Failed to begin compute pass: %s", SDL_GetError());
+                return false;
+            }
+            SDL_BindGPUComputePipeline(computePass, WavefrontScanPipeline);
+            SDL_DispatchGPUCompute(computePass, 1, 1, 1);
+            SDL_EndGPUComputePass(computePass);
+        }
+        {
+            SDL_GPUStorageBufferReadWriteBinding writeBuffers[2]{};
+            writeBuffers[0].buffer = SortBuffer;
+            writeBuffers[1].buffer = OrderBuffer;
+            SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(commandBuffer, nullptr, 0, writeBuffers, 2);
+            if (!computePass)
+            {
+                SDL_Log("Failed to begin compute pass: %s", SDL_GetError());
+                return false;
+            }
+            SDL_GPUBuffer* readBuffers[3]{};
+            readBuffers[0] = WorldStateBuffer.GetBuffer();
+            readBuffers[1] = PathBuffers[queue];
+            readBuffers[2] = CounterBuffer;
+            SDL_BindGPUComputePipeline(computePass, WavefrontSortPipeline);
+            SDL_PushGPUComputeUniformData(commandBuffer, 0, &queue, sizeof(queue));
+            SDL_BindGPUComputeStorageBuffers(computePass, 0, readBuffers, 3);
+            SDL_DispatchGPUComputeIndirect(computePass, ArgsBuffer, 0);
+            SDL_EndGPUComputePass(computePass);
+        }
+        return true;
+    };
+    int maxBounces = WorldStateBuffer->Options.MaxBounces;
+    for (int bounce = 0; bounce < maxBounces; bounce++)
+    {
+        int queue = bounce % 2;
+        if (!prepare(queue))
+        {
+            return;
+        }
+        int32_t sorted = WorldStateBuffer->Options.RaySorting && bounce > 0;
+        if (sorted && !sort(queue))
+        {
+            return;
+        }
+        {
+            SDL_GPUStorageBufferReadWriteBinding writeBuffers[3]{};
+            writeBuffers[0].buffer = HitBuffer;
+            writeBuffers[1].buffer = PrimaryBuffer;
+            writeBuffers[2].buffer = StatsBuffer;
+            SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(commandBuffer, nullptr, 0, writeBuffers, 3);
+            if (!computePass)
+            {
+                SDL_Log("Failed to begin compute pass: %s", SDL_GetError());
+                return;
+            }
+            SDL_GPUTexture* readTextures[3]{};
+            SDL_GPUBuffer* readBuffers[5]{};
+            readTextures[0] = BlockTexture;
+            readTextures[1] = GroupTexture;
+            readTextures[2] = ChunkTexture;
+            readBuffers[0] = WorldStateBuffer.GetBuffer();
+            readBuffers[1] = BlockStateBuffer.GetBuffer();
+            readBuffers[2] = PathBuffers[queue];
+            readBuffers[3] = CounterBuffer;
+            readBuffers[4] = OrderBuffer;
+            int32_t uniforms[6]{queue, bounce, Sample, retrace, Width, sorted};
+            SDL_BindGPUComputePipeline(computePass, WavefrontExtendPipeline);
+            SDL_PushGPUComputeUniformData(commandBuffer, 0, uniforms, sizeof(uniforms));
+            SDL_BindGPUComputeStorageTextures(computePass, 0, readTextures, 3);
+            SDL_BindGPUComputeStorageBuffers(computePass, 0, readBuffers, 5);
+            SDL_DispatchGPUComputeIndirect(computePass, ArgsBuffer, 0);
+            SDL_EndGPUComputePass(computePass);
+        }
+        {
+            SDL_GPUStorageTextureReadWriteBinding writeTextures[2]{};
+            SDL_GPUStorageBufferReadWriteBinding writeBuffers[5]{};
+            writeTextures[0].texture = SampleTexture;
+            writeTextures[1].texture = FeatureTexture;
+            writeBuffers[0].buffer = PathBuffers[1 - queue];
+            writeBuffers[1].buffer = ShadowBuffer;
+            writeBuffers[2].buffer = CounterBuffer;
+            writeBuffers[3].buffer = SunCacheBuffer;
+            writeBuffers[4].buffer = StatsBuffer;
+            SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(commandBuffer, writeTextures, 2, writeBuffers, 5);
+            if (!computePass)
+            {
+                SDL_Log("Failed to begin compute pass: %s", SDL_GetError());
+                return;
+            }
+            SDL_GPUTexture* readTextures[4]{};
+            SDL_GPUBuffer* readBuffers[8]{};
+            readTextures[0] = BlockTexture;
+            readTextures[1] = GroupTexture;
+            readTextures[2] = ChunkTexture;
+            readTextures[3] = BlueNoiseTexture;
+            readBuffers[0] = camera.GetBuffer();
+            readBuffers[1] = WorldStateBuffer.GetBuffer();
+            readBuffers[2] = BlockStateBuffer.GetBuffer();
+            readBuffers[3] = PathBuffers[queue];
+            readBuffers[4] = HitBuffer;
+            readBuffers[5] = LightsBuffer.GetBuffer();
+            readBuffers[6] = ReservoirBuffers[ReservoirHistory];
+            readBuffers[7] = RadianceCacheBuffer;
+            int32_t uniforms[2]{bounce, Sample};
+            SDL_BindGPUComputePipeline(computePass, WavefrontShadePipeline);
+            SDL_PushGPUComputeUniformData(commandBuffer, 0, uniforms, sizeof(uniforms));
+            SDL_BindGPUComputeStorageTextures(computePass, 0, readTextures, 4);
+            SDL_BindGPUComputeStorageBuffers(computePass, 0, readBuffers, 8);
+            SDL_DispatchGPUComputeIndirect(computePass, ArgsBuffer, 0);
+            SDL_EndGPUComputePass(computePass);
+        }
+        if (!prepare(2))
+        {
+            return;
+        }
+        {
+            SDL_GPUStorageTextureReadWriteBinding writeTexture{};
+            SDL_GPUStorageBufferReadWriteBinding writeBuffer{};
+            writeTexture.texture = SampleTexture;
+            writeBuffer.buffer = SunCacheBuffer;
+            SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(commandBuffer, &writeTexture, 1, &writeBuffer, 1);
+            if (!computePass)
+            {
+                SDL_Log("Failed to begin compute pass: %s", SDL_GetError());
+                return;
+            }
+            SDL_GPUTexture* readTextures[3]{};
+            SDL_GPUBuffer* readBuffers[4]{};
+            readTextures[0] = BlockTexture;
+            readTextures[1] = GroupTexture;
+            readTextures[2] = ChunkTexture;
+            readBuffers[0] = WorldStateBuffer.GetBuffer();
+            readBuffers[1] = BlockStateBuffer.GetBuffer();
+            readBuffers[2] = ShadowBuffer;
+            readBuffers[3] = CounterBuffer;
+            SDL_BindGPUComputePipeline(computePass, WavefrontShadowPipeline);
+            SDL_BindGPUComputeStorageTextures(computePass, 0, readTextures, 3);
+            SDL_BindGPUComputeStorageBuffers(computePass, 0, readBuffers, 4);
+            SDL_DispatchGPUComputeIndirect(computePass, ArgsBuffer, sizeof(SDL_GPUIndirectDispatchCommand));
+            SDL_EndGPUComputePass(computePass);
+        }
+    }
+}
+
+void World::RenderRestir(SDL_GPUCommandBuffer* commandBuffer, Camera& camera, bool reset, bool retrace)
+{
+    DebugGroupBlock(commandBuffer, "World::Render::Restir");
+    int32_t flags[4]{Sample, reset, Width, Height};
+    int groupsX = (Width + RESTIR_THREADS_X - 1) / RESTIR_THREADS_X;
+    int groupsY = (Height + RESTIR_THREADS_Y - 1) / RESTIR_THREADS_Y;
+    {
+        // Initial candidates merged with last frame's reservoirs
+        SDL_GPUStorageBufferReadWriteBinding writeBuffers[2]{};
+        writeBuffers[0].buffer = CandidateBuffer;
+        writeBuffers[1].buffer = SurfaceBuffers[1 - ReservoirHistory];
+        SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(commandBuffer, nullptr, 0, writeBuffers, 2);
+        if (!computePass)
+        {
+            SDL_Log("Failed to begin compute pass: %s", SDL_GetError());
+            return;
+        }
+        SDL_GPUTexture* readTextures[5]{};
+        SDL_GPUBuffer* readBuffers[8]{};
+        readTextures[0] = BlockTexture;
+        readTextures[1] = GroupTexture;
+        readTextures[2] = ChunkTexture;
+        readTextures[3] = BlueNoiseTexture;
+        readTextures[4] = TileTexture;
+        readBuffers[0] = camera.GetBuffer();
+        readBuffers[1] = PreviousCameraBuffer.GetBuffer();
+        readBuffers[2] = WorldStateBuffer.GetBuffer();
+        readBuffers[3] = BlockStateBuffer.GetBuffer();
+        readBuffers[4] = LightsBuffer.GetBuffer();
+        readBuffers[5] = ReservoirBuffers[ReservoirHistory];
+        readBuffers[6] = SurfaceBuffers[ReservoirHistory];
+        readBuffers[7] = PrimaryBuffer;
+        int32_t initialFlags[5]{Sample, reset, Width, Height, retrace};
+        SDL_BindGPUComputePipeline(computePass, RestirInitialPipeline);
+        SDL_PushGPUComputeUniformData(commandBuffer, 0, initialFlags, sizeof(initialFlags));
+        SDL_BindGPUComputeStorageTextures(computePass, 0, readTextures, 5);
+        SDL_BindGPUComputeStorageBuffers(computePass, 0, readBuffers, 8);
+        SDL_DispatchGPUCompute(computePass, groupsX, groupsY, 1);
+        SDL_EndGPUComputePass(computePass);
+    }
+    ReservoirHistory = 1 - ReservoirHistory;
+    {
+        SDL_GPUStorageBufferReadWriteBinding writeBuffer{};
+        writeBuffer.buffer = ReservoirBuffers[ReservoirHistory];
+        SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(commandBuffer, nullptr, 0, &writeBuffer, 1);
+        if (!computePass)
+        {
+            SDL_Log("Failed to begin compute pass: %s", SDL_GetError());
+            return;
+        }
+        SDL_GPUTexture* readTextures[3]{};
+        SDL_GPUBuffer* readBuffers[4]{};
+        readTextures[0] = BlockTexture;
+        readTextures[1] = GroupTexture;
+        readTextures[2] = ChunkTexture;
+        readBuffers[0] = WorldStateBuffer.GetBuffer();
+        readBuffers[1] = BlockStateBuffer.GetBuffer();
+        readBuffers[2] = CandidateBuffer;
+        readBuffers[3] = SurfaceBuffers[ReservoirHistory];
+        SDL_BindGPUComputePipeline(computePass, RestirSpatialPipeline);
+        SDL_PushGPUComputeUniformData(commandBuffer, 0, flags, sizeof(flags));
+        SDL_BindGPUComputeStorageTextures(computePass, 0, readTextures, 3);
+        SDL_BindGPUComputeStorageBuffers(computePass, 0, readBuffers, 4);
+        SDL_DispatchGPUCompute(computePass, groupsX, groupsY, 1);
+        SDL_EndGPUComputePass(computePass);
+    }
+}
+
+void World::RenderRadianceCache(SDL_GPUCommandBuffer* commandBuffer, Camera& camera, bool reset, int edits)
+{
+    DebugGroupBlock(commandBuffer, "World::Render::RadianceCache");
+    {
+        // Resolved before training so that a reset doesn't throw away this frame's samples
+        SDL_GPUStorageBufferReadWriteBinding writeBuffer{};
+        writeBuffer.buffer = RadianceCacheBuffer;
+        SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(commandBuffer, nullptr, 0, &writeBuffer, 1);
+        if (!computePass)
+        {
+            SDL_Log("Failed to begin compute pass: %s", SDL_GetError());
+            return;
+        }
+        int32_t flags[3]{Sample, reset, edits};
+        SDL_GPUBuffer* readBuffers[2]{};
+        readBuffers[0] = WorldStateBuffer.GetBuffer();
+        readBuffers[1] = EditsBuffer.GetBuffer();
+        SDL_BindGPUComputePipeline(computePass, RadianceResolvePipeline);
+        SDL_PushGPUComputeUniformData(commandBuffer, 0, flags, sizeof(flags));
+        SDL_BindGPUComputeStorageBuffers(computePass, 0, readBuffers, 2);
+        SDL_DispatchGPUCompute(computePass, RADIANCE_CACHE_SIZE / RADIANCE_RESOLVE_THREADS_X, 1, 1);
+        SDL_EndGPUComputePass(computePass);
+    }
+    {
+        SDL_GPUStorageBufferReadWriteBinding writeBuffer{};
+        writeBuffer.buffer = RadianceCacheBuffer;
+        SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(commandBuffer, nullptr, 0, &writeBuffer, 1);
+        if (!computePass)
+        {
+            SDL_Log("Failed to begin compute pass: %s", SDL_GetError());
+            return;
+        }
+        int tilesX = (Width + RADIANCE_TRAIN_TILE - 1) / RADIANCE_TRAIN_TILE;
+        int tilesY = (Height + RADIANCE_TRAIN_TILE - 1) / RADIANCE_TRAIN_TILE;
+        int groupsX = (tilesX + RADIANCE_TRAIN_THREADS_X - 1) / RADIANCE_TRAIN_THREADS_X;
+        int groupsY = (tilesY + RADIANCE_TRAIN_THREADS_Y - 1) / RADIANCE_TRAIN_THREADS_Y;
+        int32_t uniforms[3]{Sample, Width, Height};
+        SDL_GPUTexture* readTextures[4]{};
+        SDL_GPUBuffer* readBuffers[4]{};
+        readTextures[0] = BlockTexture;
+        readTextures[1] = GroupTexture;
+        readTextures[2] = ChunkTexture;
+        readTextures[3] = BlueNoiseTexture;
+        readBuffers[0] = camera.GetBuffer();
+        readBuffers[1] = WorldStateBuffer.GetBuffer();
+        readBuffers[2] = BlockStateBuffer.GetBuffer();
+        readBuffers[3] = LightsBuffer.GetBuffer();
+        SDL_BindGPUComputePipeline(computePass, RadianceTrainPipeline);
+        SDL_PushGPUComputeUniformData(commandBuffer, 0, uniforms, sizeof(uniforms));
+        SDL_BindGPUComputeStorageTextures(computePass, 0, readTextures, 4);
+        SDL_BindGPUComputeStorageBuffers(computePass, 0, readBuffers, 4);
         SDL_DispatchGPUCompute(computePass, groupsX, groupsY, 1);
         SDL_EndGPUComputePass(computePass);
     }
@@ -642,8 +2181,106 @@ bool World::WorldToLocalPosition(glm::ivec3& position) const
         position.z < Chunk::kWidth * World::kWidth;
 }
 
+void World::QueueChunk(int outX, int outZ)
+{
+    Chunk& chunk = Chunks[outX][outZ];
+    if (!(chunk.GetFlags() & ChunkFlagsQueued))
+    {
+        chunk.SetNext(PendingChunks);
+        PendingChunks = &chunk;
+    }
+    chunk.AddFlags(ChunkFlagsGenerate | ChunkFlagsQueued);
+    if (!Lights[outX][outZ].empty())
+    {
+        Lights[outX][outZ].clear();
+        LightsDirty = true;
+    }
+}
+
+void World::SetChunk(int inX, int inZ)
+{
+    int outX = ChunkMap[inX][inZ].x;
+    int outZ = ChunkMap[inX][inZ].y;
+    ChunkFlags flags = Chunks[outX][outZ].GetFlags();
+    if ((flags & ChunkFlagsGenerate) && !(flags & ChunkFlagsPreview))
+    {
+        SetChunksBuffer.Emplace(Device, inX, inZ, outX | CHUNK_PENDING, outZ);
+    }
+    else
+    {
+        SetChunksBuffer.Emplace(Device, inX, inZ, outX, outZ);
+    }
+}
+
+void World::SaveChunk(int inX, int inZ)
+{
+    int outX = ChunkMap[inX][inZ].x;
+    int outZ = ChunkMap[inX][inZ].y;
+    if (Chunks[outX][outZ].GetFlags() & ChunkFlagsGenerate)
+    {
+        return;
+    }
+    WorldCacheEntry* entry = &Cache[0];
+    for (int i = 0; i < kCacheSize; i++)
+    {
+        if (!Cache[i].Valid)
+        {
+            entry = &Cache[i];
+            break;
+        }
+        if (Cache[i].Time < entry->Time)
+        {
+            entry = &Cache[i];
+        }
+    }
+    entry->Position = {WorldStateBuffer->X + inX, WorldStateBuffer->Z + inZ};
+    entry->Time = ++CacheTime;
+    entry->Valid = true;
+    for (int i = 0; i < Chunk::kWidth; i++)
+    for (int y = 0; y < Chunk::kHeight; y++)
+    {
+        int x = outX * Chunk::kWidth + i;
+        int z = outZ * Chunk::kWidth;
+        std::memcpy(entry->Blocks[i][y], &Blocks[x][y][z], Chunk::kWidth * sizeof(Block));
+    }
+}
+
+int World::FindChunk(int chunkX, int chunkZ) const
+{
+    for (int i = 0; i < kCacheSize; i++)
+    {
+        if (Cache[i].Valid && Cache[i].Position == glm::ivec2{chunkX, chunkZ})
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void World::LoadChunk(WorldProxy& proxy, int cacheIndex, int outX, int outZ)
+{
+    WorldCacheEntry& entry = Cache[cacheIndex];
+    SDL_assert(entry.Valid);
+    for (int i = 0; i < Chunk::kWidth; i++)
+    for (int y = 0; y < Chunk::kHeight; y++)
+    for (int j = 0; j < Chunk::kWidth; j++)
+    {
+        if (entry.Blocks[i][y][j] != BlockAir)
+        {
+            proxy.SetBlock({i, y, j}, entry.Blocks[i][y][j]);
+        }
+        if (IsLight(entry.Blocks[i][y][j]))
+        {
+            int x = entry.Position.x * Chunk::kWidth + i;
+            int z = entry.Position.y * Chunk::kWidth + j;
+            Lights[outX][outZ].emplace_back(x, y, z);
+        }
+    }
+}
+
 void World::SetBlock(glm::ivec3 position, Block block)
 {
+    glm::ivec3 worldPosition = position;
     if (WorldToLocalPosition(position))
     {
         int chunkX = position.x / Chunk::kWidth;
@@ -654,9 +2291,32 @@ void World::SetBlock(glm::ivec3 position, Block block)
         // in the same compute pass, the order on the GPU is undefined since there's no barrier
         SetBlocksBuffers[0].Emplace(Device, position, block);
         SetBlocksBufferCount = std::max(SetBlocksBufferCount, 1);
-        UpdateGroups.insert({chunkX, chunkZ});
+        UpdateGroups.set(chunkX * kWidth + chunkZ);
+        std::vector<glm::ivec3>& lights = Lights[chunkX][chunkZ];
+        auto it = std::find(lights.begin(), lights.end(), worldPosition);
+        if (it != lights.end())
+        {
+            lights.erase(it);
+            LightsDirty = true;
+        }
+        if (IsLight(block))
+        {
+            lights.push_back(worldPosition);
+            LightsDirty = true;
+        }
         Blocks[position.x][position.y][position.z] = block;
-        Dirty = true;
+        // Only invalidate the history around the edit unless there's too many to check per pixel
+        if (EditCount < kMaxEdits)
+        {
+            EditsBuffer.Emplace(Device, worldPosition, 0);
+            EditCount++;
+        }
+        else
+        {
+            SunDirty = true;
+            RadianceDirty = true;
+            Dirty = true;
+        }
     }
     else
     {
@@ -664,6 +2324,11 @@ void World::SetBlock(glm::ivec3 position, Block block)
     }
 }
 
+bool World::IsLight(Block block) const
+{
+    return (*BlockStateBuffer)[block].Light > 0.0f;
+}
+
 Block World::GetBlock(glm::ivec3 position) const
 {
     if (WorldToLocalPosition(position))
@@ -745,8 +2410,234 @@ WorldQuery World::Raycast(const glm::vec3& position, const glm::vec3& direction,
 void World::SetOptions(const WorldOptions& options)
 {
     WorldState& state = WorldStateBuffer.Get();
+    WorldOptions previous = state.Options;
     state.Options = options;
+    // A benchmark holds adaptive sampling off until it stops
+    if (BenchmarkSample >= 0)
+    {
+        BenchmarkThreshold = options.AdaptiveThreshold;
+        state.Options.AdaptiveThreshold = 0.0f;
+    }
     float theta = (options.TimeOfDay - 6.0f) / 12.0f * glm::pi<float>();
     state.Options.SunDirection = glm::normalize(glm::vec3(std::cos(theta), std::sin(theta), 0.0f));
+    // The sun cache stays valid through any other option
+    if (state.Options.SunDirection != previous.SunDirection)
+    {
+        SunDirty = true;
+    }
+    // The radiance cache only holds lighting so it survives anything but the sky and sun changing
+    if (state.Options.SunDirection != previous.SunDirection ||
+        state.Options.SkyBottom != previous.SkyBottom ||
+        state.Options.SkyTop != previous.SkyTop ||
+        state.Options.SunColor != previous.SunColor ||
+        state.Options.SunIntensity != previous.SunIntensity)
+    {
+        RadianceDirty = true;
+    }
+    // Exposure and tonemapping only apply when resolving so the accumulated image stays valid
+    WorldOptions resolve = previous;
+    resolve.Exposure = state.Options.Exposure;
+    resolve.Tonemapper = state.Options.Tonemapper;
+    if (std::memcmp(&resolve, &state.Options, sizeof(WorldOptions)) != 0)
+    {
+        Dirty = true;
+    }
+}
+
+void World::CaptureReference()
+{
+    CaptureRequested = true;
+}
+
+void World::StartBenchmark()
+{
+    if (Reference.empty())
+    {
+        SDL_Log("No reference to benchmark against");
+        return;
+    }
+    if (BenchmarkSample >= 0)
+    {
+        StopBenchmark();
+    }
+    // Converges from scratch like any other reset, without skipping converged pixels
+    BenchmarkSample = 0;
+    BenchmarkThreshold = WorldStateBuffer->Options.AdaptiveThreshold;
+    WorldStateBuffer.Get().Options.AdaptiveThreshold = 0.0f;
     Dirty = true;
 }
+
+bool World::HasReference() const
+{
+    return !Reference.empty();
+}
+
+const WorldStats& World::GetStats() const
+{
+    return Stats;
+}
+
+// Only used on the CPU so changing it doesn't touch the uploaded state
+void World::SetHysteresis(float hysteresis)
+{
+    Hysteresis = hysteresis;
+}
+
+float World::GetHysteresis() const
+{
+    return Hysteresis;
+}
+
+void World::ReadStats()
+{
+    // The oldest download, the next one to be overwritten
+    SDL_GPUTransferBuffer* transferBuffer = StatsDownloadBuffers[StatsFrame % kStatsLatency];
+    const void* mapped = SDL_MapGPUTransferBuffer(Device, transferBuffer, false);
+    if (!mapped)
+    {
+        SDL_Log("Failed to map transfer buffer: %s", SDL_GetError());
+        return;
+    }
+    std::memcpy(&Stats, mapped, sizeof(Stats));
+    SDL_UnmapGPUTransferBuffer(Device, transferBuffer);
+}
+
+void World::RenderBenchmark(SDL_GPUCommandBuffer* commandBuffer, bool reset)
+{
+    // Anything but the reset that started it restarts the accumulation and spoils the result
+    if ((BenchmarkSample > 0 && reset) || (BenchmarkSample >= 0 && (Width != ReferenceWidth || Height != ReferenceHeight)))
+    {
+        SDL_Log("Benchmark interrupted since the view changed");
+        StopBenchmark();
+    }
+    if (BenchmarkSample >= 0)
+    {
+        BenchmarkSample++;
+    }
+    // Only reads back at powers of two to report the error against the sample count on a log scale
+    bool benchmark = BenchmarkSample > 0 && (BenchmarkSample & (BenchmarkSample - 1)) == 0;
+    if (!CaptureRequested && !benchmark)
+    {
+        return;
+    }
+    DebugGroupBlock(commandBuffer, "World::Render::Benchmark");
+    bool half = ColorFormat == SDL_GPU_TEXTUREFORMAT_R16G16B16A16_FLOAT;
+    int size = Width * Height * (half ? 4 * sizeof(uint16_t) : sizeof(glm::vec4));
+    if (DownloadSize != size || DownloadHalf != half)
+    {
+        // Downloads still in flight were of another size so they're dropped
+        for (int i = 0; i < kStatsLatency; i++)
+        {
+            SDL_ReleaseGPUTransferBuffer(Device, DownloadBuffers[i]);
+            DownloadBuffers[i] = nullptr;
+            DownloadFrames[i] = -1;
+        }
+        DownloadSize = 0;
+        SDL_GPUTransferBufferCreateInfo info{};
+        info.usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD;
+        info.size = size;
+        for (int i = 0; i < kStatsLatency; i++)
+        {
+            DownloadBuffers[i] = SDL_CreateGPUTransferBuffer(Device, &info);
+            if (!DownloadBuffers[i])
+            {
+                SDL_Log("Failed to create transfer buffer: %s", SDL_GetError());
+                return;
+            }
+        }
+        DownloadSize = size;
+        DownloadHalf = half;
+    }
+    SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(commandBuffer);
+    if (!copyPass)
+    {
+        SDL_Log("Failed to begin copy pass: %s", SDL_GetError());
+        return;
+    }
+    // Shares the slot of this frame's stats so it's read back just as late
+    int slot = (StatsFrame - 1) % kStatsLatency;
+    SDL_GPUTextureRegion source{};
+    SDL_GPUTextureTransferInfo destination{};
+    source.texture = ColorTextures[History];
+    source.w = Width;
+    source.h = Height;
+    source.d = 1;
+    destination.transfer_buffer = DownloadBuffers[slot];
+    SDL_DownloadFromGPUTexture(copyPass, &source, &destination);
+    SDL_EndGPUCopyPass(copyPass);
+    DownloadFrames[slot] = CaptureRequested ? 0 : BenchmarkSample;
+    CaptureRequested = false;
+}
+
+void World::ReadBenchmark()
+{
+    // The oldest download, the same one the stats were just read from
+    int slot = StatsFrame % kStatsLatency;
+    int frames = DownloadFrames[slot];
+    DownloadFrames[slot] = -1;
+    const void* mapped = SDL_MapGPUTransferBuffer(Device, DownloadBuffers[slot], false);
+    if (!mapped)
+    {
+        SDL_Log("Failed to map transfer buffer: %s", SDL_GetError());
+        return;
+    }
+    std::vector<glm::vec4> pixels;
+    if (DownloadHalf)
+    {
+        const uint16_t* values = static_cast<const uint16_t*>(mapped);
+        pixels.resize(DownloadSize / (4 * sizeof(uint16_t)));
+        for (int i = 0; i < pixels.size(); i++)
+        {
+            for (int j = 0; j < 4; j++)
+            {
+                pixels[i][j] = HalfToFloat(values[i * 4 + j]);
+            }
+        }
+    }
+    else
+    {
+        const glm::vec4* values = static_cast<const glm::vec4*>(mapped);
+        pixels.assign(values, values + DownloadSize / sizeof(glm::vec4));
+    }
+    SDL_UnmapGPUTransferBuffer(Device, DownloadBuffers[slot]);
+    const glm::vec4* data = pixels.data();
+    int count = pixels.size();
+    if (frames == 0)
+    {
+        Reference.assign(data, data + count);
+        ReferenceWidth = Width;
+        ReferenceHeight = Height;
+        SDL_Log("Captured reference");
+    }
+    else if (count == int(Reference.size()))
+    {
+        // Foveation still skips pixels so the samples are counted from the history rather than the frames
+        double error = 0.0;
+        double samples = 0.0;
+        for (int i = 0; i < count; i++)
+        {
+            glm::vec3 difference = glm::vec3(data[i]) - glm::vec3(Reference[i]);
+            error += glm::dot(difference, difference) / 3.0;
+            samples += data[i].w;
+        }
+        SDL_Log("Benchmark: %d frames, %.1f samples per pixel, RMSE %f", frames, samples / count, std::sqrt(error / count));
+    }
+    if (frames >= BENCHMARK_SAMPLES)
+    {
+        StopBenchmark();
+    }
+}
+
+void World::StopBenchmark()
+{
+    BenchmarkSample = -1;
+    WorldStateBuffer.Get().Options.AdaptiveThreshold = BenchmarkThreshold;
+    // Downloads still in flight belong to the stopped benchmark but a pending reference is kept
+    for (int i = 0; i < kStatsLatency; i++)
+    {
+        if (DownloadFrames[i] > 0)
+        {
+            DownloadFrames[i] = -1;
+        }
+    }
+}
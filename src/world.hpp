@@ -3,15 +3,14 @@
 #include <SDL3/SDL.h>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
-#include <glm/gtx/hash.hpp>
 
 #include <cstdint>
 #include <vector>
 #include <array>
 #include <algorithm>
+#include <bitset>
 #include <execution>
 #include <thread>
-#include <unordered_set>
 
 #include "block.hpp"
 #include "buffer.hpp"
@@ -57,6 +56,24 @@ struct WorldOptions
     float SunIntensity;
     glm::vec3 SunDirection;
     float TimeOfDay;
+    int32_t Temporal;
+    int32_t MaxHistory;
+    int32_t DenoiseIterations;
+    float EditRadius;
+    int32_t Wavefront;
+    int32_t Restir;
+    int32_t RadianceCache;
+    int32_t SunCache;
+    float AdaptiveThreshold;
+    int32_t UpscaleFactor;
+    int32_t Sampler;
+    int32_t RetraceInterval;
+    int32_t RaySorting;
+    int32_t HalfAccumulation;
+    float Exposure;
+    int32_t Tonemapper;
+    int32_t Foveated;
+    float FoveaRadius;
 };
 
 struct WorldState
@@ -64,13 +81,120 @@ struct WorldState
     WorldOptions Options;
     int32_t X;
     int32_t Z;
+    int32_t LightCount;
+    int32_t Padding2;
 };
 
+struct PathState
+{
+    glm::vec3 Origin;
+    uint32_t Pixel;
+    glm::vec3 Direction;
+    float IOR;
+    glm::vec3 Throughput;
+    uint32_t Seed;
+    float BsdfPdf;
+    float Roughness;
+    float LightProbability;
+    float Padding1;
+};
+
+struct PathHit
+{
+    glm::vec3 Position;
+    uint32_t Block;
+    glm::vec3 Normal;
+    uint32_t Flags;
+};
+
+struct PrimaryHit
+{
+    glm::vec3 Position;
+    uint32_t Block;
+    glm::vec3 Normal;
+    uint32_t Flags;
+    glm::vec3 Direction;
+    float IOR;
+};
+
+struct ShadowRay
+{
+    glm::vec3 Origin;
+    uint32_t Pixel;
+    glm::vec3 Direction;
+    float Distance;
+    glm::vec3 Radiance;
+    uint32_t Cell;
+};
+
+struct Reservoir
+{
+    glm::vec3 Target;
+    uint32_t Block;
+    glm::vec3 Normal;
+    float WeightSum;
+    float M;
+    float W;
+    float Padding1;
+    float Padding2;
+};
+
+struct ReservoirSurface
+{
+    glm::vec3 Position;
+    uint32_t Block;
+    glm::vec3 Normal;
+    float Depth;
+};
+
+struct RadianceCell
+{
+    glm::ivec3 Voxel;
+    uint32_t Checksum;
+    glm::vec3 Radiance;
+    float Samples;
+    uint32_t SumR;
+    uint32_t SumG;
+    uint32_t SumB;
+    uint32_t Count;
+    uint32_t Face;
+    uint32_t Frame;
+    uint32_t Padding1;
+    uint32_t Padding2;
+};
+
+struct SunCell
+{
+    glm::ivec3 Voxel;
+    uint32_t State;
+};
+
+// Counted by the raytracer every frame, the paths it started and how many the step and bounce limits cut short
+struct WorldStats
+{
+    uint32_t Paths;
+    uint32_t StepLimit;
+    uint32_t BounceLimit;
+    uint32_t Padding1;
+};
+
+static_assert(sizeof(PathState) == 64);
+static_assert(sizeof(PathHit) == 32);
+static_assert(sizeof(PrimaryHit) == 48);
+static_assert(sizeof(ShadowRay) == 48);
+static_assert(sizeof(Reservoir) == 48);
+static_assert(sizeof(ReservoirSurface) == 32);
+static_assert(sizeof(RadianceCell) == 64);
+static_assert(sizeof(SunCell) == 16);
+static_assert(sizeof(WorldStats) == 16);
+
 class WorldProxy
 {
 public:
     WorldProxy(World& handle, DynamicBuffer<WorldSetBlockJob>& buffer, int chunkX, int chunkZ);
+    void Clear();
     void SetBlock(glm::ivec3 position, Block block);
+    Block GetBlock(glm::ivec3 position) const;
 
 private:
     World& Handle;
@@ -79,6 +203,14 @@ private:
     int Z;
 };
 
+struct WorldCacheEntry
+{
+    glm::ivec2 Position;
+    uint64_t Time;
+    bool Valid;
+    Block Blocks[Chunk::kWidth][Chunk::kHeight][Chunk::kWidth];
+};
+
 struct WorldQuery
 {
     Block HitBlock;
@@ -93,6 +225,11 @@ private:
 
 public:
     static constexpr int kWidth = WORLD_WIDTH;
+    static constexpr int kCacheSize = WORLD_WIDTH * 2;
+    static constexpr int kPreviewsPerJob = 8;
+    static constexpr int kMaxEdits = 64;
+    static constexpr int kMaxLights = 4096;
+    static constexpr int kStatsLatency = 3;
 
     World();
     World(const World& other) = delete;
@@ -108,36 +245,138 @@ public:
     Block GetBlock(glm::ivec3 position) const;
     WorldQuery Raycast(const glm::vec3& position, const glm::vec3& direction, float length);
     void SetOptions(const WorldOptions& options);
+    void CaptureReference();
+    void StartBenchmark();
+    bool HasReference() const;
+    const WorldStats& GetStats() const;
+    void SetHysteresis(float hysteresis);
+    float GetHysteresis() const;
 
 private:
     bool WorldToLocalPosition(glm::ivec3& position) const;
+    void RenderWavefront(SDL_GPUCommandBuffer* commandBuffer, Camera& camera, bool retrace);
+    void RenderRestir(SDL_GPUCommandBuffer* commandBuffer, Camera& camera, bool reset, bool retrace);
+    void RenderRadianceCache(SDL_GPUCommandBuffer* commandBuffer, Camera& camera, bool reset, int edits);
+    void RenderBenchmark(SDL_GPUCommandBuffer* commandBuffer, bool reset);
+    void ReadBenchmark();
+    void StopBenchmark();
+    void ReadStats();
+    void GenerateTiles(const glm::ivec2* jobs, int numChunks, int tilesPerChunk);
+    void QueueChunk(int outX, int outZ);
+    void SetChunk(int inX, int inZ);
+    void SaveChunk(int inX, int inZ);
+    int FindChunk(int chunkX, int chunkZ) const;
+    void LoadChunk(WorldProxy& proxy, int cacheIndex, int outX, int outZ);
+    bool IsLight(Block block) const;
 
 private:
     SDL_GPUDevice* Device;
     Block Blocks[kWidth * Chunk::kWidth][Chunk::kHeight][kWidth * Chunk::kWidth];
     Chunk Chunks[kWidth][kWidth];
     glm::ivec2 ChunkMap[kWidth][kWidth];
+    WorldCacheEntry Cache[kCacheSize];
+    uint64_t CacheTime;
     std::vector<DynamicBuffer<WorldSetBlockJob>> SetBlocksBuffers;
     int SetBlocksBufferCount;
-    std::unordered_set<glm::ivec2> UpdateGroups;
+    std::vector<ChunkTree> Trees;
+    Chunk* PendingChunks;
+    glm::ivec2 InverseChunkMap[kWidth][kWidth];
+    std::vector<glm::ivec2> Jobs;
+    std::vector<int> JobIndices;
+    std::vector<int> CacheIndices;
+    size_t JobsCapacity;
+    size_t OutOfBoundsCapacity;
+    size_t ClearCapacity;
+    std::vector<glm::ivec2> OutOfBoundsChunks;
+    std::bitset<kWidth * kWidth> UpdateGroups;
     DynamicBuffer<WorldSetChunkJob> SetChunksBuffer;
     std::vector<glm::ivec2> ClearChunks;
     StaticBuffer<WorldState> WorldStateBuffer;
+    float Hysteresis;
     StaticBuffer<BlockState> BlockStateBuffer;
+    StaticBuffer<CameraState> PreviousCameraBuffer;
+    DynamicBuffer<glm::ivec4> EditsBuffer;
+    int EditCount;
+    std::vector<glm::ivec3> Lights[kWidth][kWidth];
+    DynamicBuffer<glm::ivec4> LightsBuffer;
+    bool LightsDirty;
+    SDL_GPUBuffer* PathBuffers[2];
+    SDL_GPUBuffer* HitBuffer;
+    SDL_GPUBuffer* ShadowBuffer;
+    SDL_GPUBuffer* CounterBuffer;
+    SDL_GPUBuffer* ArgsBuffer;
+    SDL_GPUBuffer* ReservoirBuffers[2];
+    SDL_GPUBuffer* SurfaceBuffers[2];
+    SDL_GPUBuffer* CandidateBuffer;
+    SDL_GPUBuffer* RadianceCacheBuffer;
+    SDL_GPUBuffer* SunCacheBuffer;
+    SDL_GPUBuffer* PixelBuffer;
+    SDL_GPUBuffer* PixelArgsBuffer;
+    SDL_GPUBuffer* PrimaryBuffer;
+    SDL_GPUBuffer* SortBuffer;
+    SDL_GPUBuffer* OrderBuffer;
+    SDL_GPUBuffer* StatsBuffer;
     SDL_GPUTexture* BlockTexture;
     SDL_GPUTexture* GroupTexture;
     SDL_GPUTexture* ChunkTexture;
-    SDL_GPUTexture* ColorTexture;
+    SDL_GPUTexture* BlueNoiseTexture;
+    SDL_GPUTexture* SampleTexture;
+    SDL_GPUTexture* ColorTextures[2];
+    SDL_GPUTexture* FeatureTexture;
+    SDL_GPUTexture* MomentTextures[2];
+    SDL_GPUTexture* DenoiseTextures[2];
+    SDL_GPUTexture* UpscaleTextures[2];
+    SDL_GPUTexture* TileTexture;
     SDL_GPUComputePipeline* SetBlocksPipeline;
     SDL_GPUComputePipeline* SetChunksPipeline;
     SDL_GPUComputePipeline* ClearBlocksPipeline;
     SDL_GPUComputePipeline* RaytracePipeline;
-    SDL_GPUComputePipeline* ClearTexturePipeline;
+    SDL_GPUComputePipeline* AccumulatePipeline;
+    SDL_GPUComputePipeline* AccumulateHalfPipeline;
+    SDL_GPUComputePipeline* DenoisePipeline;
     SDL_GPUComputePipeline* SampleTexturePipeline;
-    SDL_GPUComputePipeline* ClearGroupsPipeline;
     SDL_GPUComputePipeline* SetGroupsPipeline;
+    SDL_GPUComputePipeline* WavefrontGeneratePipeline;
+    SDL_GPUComputePipeline* WavefrontPreparePipeline;
+    SDL_GPUComputePipeline* WavefrontExtendPipeline;
+    SDL_GPUComputePipeline* WavefrontShadePipeline;
+    SDL_GPUComputePipeline* WavefrontShadowPipeline;
+    SDL_GPUComputePipeline* WavefrontBinPipeline;
+    SDL_GPUComputePipeline* WavefrontScanPipeline;
+    SDL_GPUComputePipeline* WavefrontSortPipeline;
+    SDL_GPUComputePipeline* RestirInitialPipeline;
+    SDL_GPUComputePipeline* RestirSpatialPipeline;
+    SDL_GPUComputePipeline* RadianceTrainPipeline;
+    SDL_GPUComputePipeline* RadianceResolvePipeline;
+    SDL_GPUComputePipeline* SunInvalidatePipeline;
+    SDL_GPUComputePipeline* AllocatePipeline;
+    SDL_GPUComputePipeline* AllocatePreparePipeline;
+    SDL_GPUComputePipeline* UpscalePipeline;
+    SDL_GPUComputePipeline* TileDistancePipeline;
     int Width;
     int Height;
+    int OutputWidth;
+    int OutputHeight;
+    SDL_GPUTextureFormat ColorFormat;
     bool Dirty;
+    bool SunDirty;
+    bool RadianceDirty;
     int Sample;
+    int StillFrames;
+    int History;
+    int ReservoirHistory;
+    int UpscaleHistory;
+    std::vector<glm::vec4> Reference;
+    int ReferenceWidth;
+    int ReferenceHeight;
+    SDL_GPUTransferBuffer* DownloadBuffers[kStatsLatency];
+    int DownloadSize;
+    int DownloadFrames[kStatsLatency];
+    bool DownloadHalf;
+    bool CaptureRequested;
+    int BenchmarkSample;
+    float BenchmarkThreshold;
+    SDL_GPUTransferBuffer* StatsDownloadBuffers[kStatsLatency];
+    int StatsFrame;
+    WorldStats Stats;
 };
\ No newline at end of file